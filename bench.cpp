@@ -0,0 +1,152 @@
+// Throughput benchmarks for the encoder harness stages, on real queue data.
+//
+//   BM_Encode/<size class>/<max depth>   JsonEncoder, documents bucketed by length
+//   BM_Parse/<mask>                      CharReader::parse of the encoded corpus
+//   BM_Exec                              main2.cpp's whole runTestcase per queue entry
+//
+// The corpus is every file under the directories in BENCH_CORPUS
+// (':' separated, default out2/default/queue:out3/default/queue), read as
+// main2.cpp testcases: A,B then one encoder input per line. Rates are
+// reported as bytes/s (input bytes of the stage) and docs/s.
+//
+// Build:
+//   g++ -O2 -std=c++17 bench.cpp -ljsoncpp -lbenchmark -pthread -o bench
+// Run:
+//   ./bench --benchmark_filter=BM_Parse
+
+#include <benchmark/benchmark.h>
+#define HARNESS_ECHO 0
+#define HARNESS_NO_MAIN
+#define HARNESS_SHAPE
+#include "harness.h"
+#include "main2_testcase.h"
+
+namespace {
+
+struct Corpus {
+    std::vector<std::string> testcases;   // whole queue entries
+    std::vector<std::string> documents;   // encoder inputs (lines after A,B)
+    std::vector<std::string> json;        // documents encoded at the default limits
+};
+
+const Corpus &corpus() {
+    static const Corpus c = [] {
+        Corpus c;
+        const char *env = std::getenv("BENCH_CORPUS");
+        std::string dirs = env ? env : "out2/default/queue:out3/default/queue";
+        std::vector<std::string> args;
+        for (size_t pos = 0; pos <= dirs.size();) {
+            size_t colon = std::min(dirs.find(':', pos), dirs.size());
+            if (colon > pos)
+                args.push_back(dirs.substr(pos, colon - pos));
+            pos = colon + 1;
+        }
+        std::vector<char *> argv;
+        for (std::string &a : args)
+            argv.push_back(&a[0]);
+        for (const std::string &path : harness::collectInputs(argv.data(), argv.data() + argv.size())) {
+            harness::Input input;
+            if (!input.open(path.c_str()))
+                continue;
+            const char *text = reinterpret_cast<const char *>(input.data());
+            c.testcases.emplace_back(text, input.size());
+            if (input.size() < 2)
+                continue;
+            harness::forEachLine(text + 2, text + input.size(), [&](const char *p, const char *end) {
+                c.documents.emplace_back(p, end);
+            });
+        }
+        static char arena[JsonEncoder::outputBound(ENCODER_MAX_NODES)];
+        for (const std::string &doc : c.documents) {
+            JsonEncoder enc(reinterpret_cast<const uint8_t *>(doc.data()), doc.size());
+            c.json.emplace_back(enc.encodeIterativeInto(arena));
+        }
+        if (c.testcases.empty())
+            std::fprintf(stderr, "[bench] no corpus files under %s\n", dirs.c_str());
+        return c;
+    }();
+    return c;
+}
+
+// Document length classes for BM_Encode: [kSizeClasses[i], kSizeClasses[i + 1])
+constexpr size_t kSizeClasses[] = {0, 16, 64, 256, SIZE_MAX};
+
+void reportRates(benchmark::State &state, size_t bytes, size_t docs) {
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+    state.counters["docs"] = benchmark::Counter(static_cast<double>(docs), benchmark::Counter::kIsRate);
+}
+
+void BM_Encode(benchmark::State &state) {
+    const size_t lo = kSizeClasses[state.range(0)];
+    const size_t hi = kSizeClasses[state.range(0) + 1];
+    const size_t maxDepth = static_cast<size_t>(state.range(1));
+    std::vector<const std::string *> docs;
+    for (const std::string &doc : corpus().documents) {
+        if (doc.size() >= lo && doc.size() < hi)
+            docs.push_back(&doc);
+    }
+    if (docs.empty()) {
+        state.SkipWithError("no documents in this size class");
+        return;
+    }
+
+    static char arena[JsonEncoder::outputBound(JsonEncoder::kMaxNodes)];
+    size_t bytes = 0;
+    size_t count = 0;
+    for (auto _ : state) {
+        for (const std::string *doc : docs) {
+            JsonEncoder enc(reinterpret_cast<const uint8_t *>(doc->data()), doc->size(), maxDepth);
+            benchmark::DoNotOptimize(enc.encodeIterativeInto(arena).size());
+            bytes += enc.consumed();  // long lines stop at the node budget
+        }
+        count += docs.size();
+    }
+    reportRates(state, bytes, count);
+}
+BENCHMARK(BM_Encode)->ArgsProduct({{0, 1, 2, 3}, {8, 64, 1000}});
+
+void BM_Parse(benchmark::State &state) {
+    const unsigned mask = static_cast<unsigned>(state.range(0));
+    const std::vector<std::string> &json = corpus().json;
+    Json::CharReader &reader = harness::readerCache().get(mask);
+
+    size_t bytes = 0;
+    for (auto _ : state) {
+        for (const std::string &doc : json) {
+            harness::ParseRoot parsed;      // recycled with -DHARNESS_VALUE_ARENA
+            Json::Value &root = parsed.get();
+            std::string errs;
+            try {
+                benchmark::DoNotOptimize(reader.parse(doc.data(), doc.data() + doc.size(), &root, &errs));
+            } catch (const Json::Exception &) {
+                // stackLimit, as in main2.cpp
+            }
+            bytes += doc.size();
+        }
+    }
+    reportRates(state, bytes, json.size() * state.iterations());
+}
+// All options off, each option alone, main3.cpp's default mask and all on
+BENCHMARK(BM_Parse)->Arg(0)->RangeMultiplier(2)->Range(1, 1 << (harness::kNumOptionBits - 1))
+                   ->Arg(harness::kScalarRootOptions)->Arg(harness::kAllOptions);
+
+void BM_Exec(benchmark::State &state) {
+    const std::vector<std::string> &testcases = corpus().testcases;
+    harness::readerCache().prebuild();
+
+    size_t bytes = 0;
+    for (auto _ : state) {
+        for (const std::string &t : testcases) {
+            runTestcase(reinterpret_cast<const uint8_t *>(t.data()), t.size());
+            bytes += t.size();
+        }
+    }
+    reportRates(state, bytes, corpus().documents.size() * state.iterations());
+    state.counters["execs"] = benchmark::Counter(static_cast<double>(testcases.size() * state.iterations()),
+                                                 benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_Exec);
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,272 @@
+#!/usr/bin/env python3
+"""Run one AFL++ campaign on many cores: -M and -S instances per input format.
+
+Instances are spread over the harness variants round-robin and bound to
+cores no other process is pinned to. Variants only sync with variants that
+read the same testcase format: each format gets its own sync directory
+OUT/FORMAT with its own -M instance, since a raw A,B+JSON testcase means
+nothing to an encoder harness and vice versa. A variant's format defaults
+to its name. While instances run, the fuzzer_stats of every instance are
+summed into one view, per variant and in total. Ctrl-C stops all instances.
+
+    python3 campaign.py -o out4 \\
+        -i raw=intrim -i encoded=out2/default/queue -i masked=out3/default/queue \\
+        --variant raw=./jsoncpp_fuzz \\
+        --variant encoded=./jsoncpp_fuzz_enc,encoded \\
+        --variant encoded2=./jsoncpp_fuzz_enc_deep,encoded \\
+        --variant masked=./jsoncpp_fuzz_mask
+
+    python3 campaign.py -o out4 --status      # view a running campaign
+"""
+
+import argparse
+import os
+import re
+import shutil
+import signal
+import subprocess
+import sys
+import time
+from pathlib import Path
+
+
+def parse_cpu_list(text):
+    """'0-3,8' -> {0, 1, 2, 3, 8}"""
+    cpus = set()
+    for part in text.strip().split(","):
+        if not part:
+            continue
+        lo, _, hi = part.partition("-")
+        cpus.update(range(int(lo), int(hi or lo) + 1))
+    return cpus
+
+
+def online_cores():
+    try:
+        return parse_cpu_list(Path("/sys/devices/system/cpu/online").read_text())
+    except OSError:
+        return set(range(os.cpu_count() or 1))
+
+
+def busy_cores():
+    """Cores some live process is pinned to alone (how afl-fuzz -b marks a core)."""
+    online = online_cores()
+    busy = set()
+    for status in Path("/proc").glob("[0-9]*/status"):
+        try:
+            text = status.read_text()
+        except OSError:
+            continue
+        match = re.search(r"^Cpus_allowed_list:\s*(\S+)", text, re.M)
+        state = re.search(r"^State:\s*(\S)", text, re.M)
+        if not match or (state and state.group(1) in "ZX"):
+            continue
+        # Kernel threads have no address space; the per-CPU ones
+        # (ksoftirqd/N, migration/N, ...) would otherwise claim every core.
+        # afl-fuzz's own binding check skips them the same way.
+        if not re.search(r"^VmSize:", text, re.M):
+            continue
+        cpus = parse_cpu_list(match.group(1))
+        # On a one-core host every process "is pinned"; that is not a claim
+        if len(cpus) == 1 and cpus != online:
+            busy |= cpus
+    return busy
+
+
+def free_cores():
+    allowed = os.sched_getaffinity(0)
+    return sorted(allowed - busy_cores())
+
+
+def read_stats(path):
+    stats = {}
+    try:
+        for line in path.read_text().splitlines():
+            key, sep, value = line.partition(":")
+            if sep:
+                stats[key.strip()] = value.strip()
+    except OSError:
+        pass
+    return stats
+
+
+def number(stats, *keys):
+    for key in keys:
+        if key in stats:
+            try:
+                return float(stats[key].rstrip("%"))
+            except ValueError:
+                pass
+    return 0.0
+
+
+def instance_variants(out_dir):
+    """FORMAT/instance -> variant, from the names this launcher gives them."""
+    variants = {}
+    for stats in sorted(Path(out_dir).glob("*/*/fuzzer_stats")):
+        name = stats.parent.name
+        key = f"{stats.parent.parent.name}/{name}"
+        variants[key] = name.rsplit("-", 1)[0] if "-" in name else name
+    return variants
+
+
+def show_status(out_dir, variant_of):
+    totals = {}
+    for name, variant in sorted(variant_of.items()):
+        stats = read_stats(Path(out_dir) / name / "fuzzer_stats")
+        if not stats:
+            continue
+        t = totals.setdefault(variant, {"instances": 0, "execs_done": 0.0, "execs_per_sec": 0.0,
+                                        "corpus_count": 0.0, "crashes": 0.0, "hangs": 0.0,
+                                        "edges_found": 0.0, "bitmap_cvg": 0.0})
+        t["instances"] += 1
+        t["execs_done"] += number(stats, "execs_done")
+        t["execs_per_sec"] += number(stats, "execs_per_sec")
+        t["corpus_count"] += number(stats, "corpus_count", "paths_total")
+        t["crashes"] += number(stats, "saved_crashes", "unique_crashes")
+        t["hangs"] += number(stats, "saved_hangs", "unique_hangs")
+        # Coverage maps differ between variants, so only the best instance counts
+        t["edges_found"] = max(t["edges_found"], number(stats, "edges_found"))
+        t["bitmap_cvg"] = max(t["bitmap_cvg"], number(stats, "bitmap_cvg"))
+
+    header = f"{'variant':<12}{'inst':>5}{'execs/s':>12}{'execs':>14}{'corpus':>9}{'crashes':>9}{'hangs':>7}{'edges':>8}{'cvg%':>7}"
+    print(time.strftime("%H:%M:%S"), f"campaign {out_dir}")
+    print(header)
+    total = {"instances": 0, "execs_per_sec": 0.0, "execs_done": 0.0, "corpus_count": 0.0,
+             "crashes": 0.0, "hangs": 0.0}
+    for variant, t in sorted(totals.items()):
+        print(f"{variant:<12}{t['instances']:>5}{t['execs_per_sec']:>12.0f}{t['execs_done']:>14.0f}"
+              f"{t['corpus_count']:>9.0f}{t['crashes']:>9.0f}{t['hangs']:>7.0f}"
+              f"{t['edges_found']:>8.0f}{t['bitmap_cvg']:>7.2f}")
+        for key in total:
+            total[key] += t[key]
+    print(f"{'total':<12}{total['instances']:>5}{total['execs_per_sec']:>12.0f}{total['execs_done']:>14.0f}"
+          f"{total['corpus_count']:>9.0f}{total['crashes']:>9.0f}{total['hangs']:>7.0f}")
+    print()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Multi-core AFL++ campaign launcher")
+    parser.add_argument("-i", "--input", action="append", default=[], metavar="[FORMAT=]DIR",
+                        help="Seed directory, for every format or for FORMAT only; repeatable")
+    parser.add_argument("-o", "--output", required=True, help="AFL++ sync/output directory")
+    parser.add_argument("--variant", action="append", default=[], metavar="NAME=BINARY[,FORMAT]",
+                        help="Harness variant and its input format (default: NAME); repeat for several. "
+                             "The first variant of each format runs that format's -M instance")
+    parser.add_argument("-j", "--jobs", type=int, help="Instances to start (default: one per free core)")
+    parser.add_argument("--afl-fuzz", default="afl-fuzz", help="afl-fuzz binary")
+    parser.add_argument("--afl-args", default="", help="Extra afl-fuzz arguments, e.g. '-t 1000'")
+    parser.add_argument("--interval", type=float, default=10.0, help="Seconds between status views")
+    parser.add_argument("--duration", type=float, help="Stop all instances after this many seconds")
+    parser.add_argument("--status", action="store_true", help="Only show the stats of a running campaign")
+    parser.add_argument("--dry-run", action="store_true", help="Print the afl-fuzz commands and exit")
+    args = parser.parse_args()
+
+    if args.status:
+        variant_of = instance_variants(args.output)
+        if not variant_of:
+            sys.exit(f"[!] No fuzzer_stats under {args.output}")
+        show_status(args.output, variant_of)
+        return
+
+    if not args.input or not args.variant:
+        parser.error("--input and at least one --variant are required to launch")
+
+    variants = []
+    for spec in args.variant:
+        name, sep, rest = spec.partition("=")
+        binary, _, fmt = rest.partition(",")
+        fmt = fmt or name
+        if not sep or not name or "-" in name or "/" in fmt:
+            parser.error(f"bad --variant {spec!r}: want NAME=BINARY[,FORMAT], NAME without '-'")
+        if not Path(binary).is_file():
+            sys.exit(f"[!] Harness not found: {binary}")
+        variants.append((name, str(Path(binary).resolve()), fmt))
+
+    seeds = {}
+    for spec in args.input:
+        fmt, sep, directory = spec.rpartition("=")
+        seeds[fmt if sep else None] = directory
+    for _, _, fmt in variants:
+        if seeds.get(fmt, seeds.get(None)) is None:
+            parser.error(f"no seed directory for format {fmt!r}: pass -i DIR or -i {fmt}=DIR")
+
+    cores = free_cores()
+    jobs = args.jobs or len(cores)
+    if jobs > len(cores):
+        print(f"[!] Only {len(cores)} free cores; starting {len(cores)} instances instead of {jobs}")
+        jobs = len(cores)
+    if jobs == 0:
+        sys.exit("[!] No free cores")
+    if not args.dry_run and not shutil.which(args.afl_fuzz) and not Path(args.afl_fuzz).is_file():
+        sys.exit(f"[!] afl-fuzz not found: {args.afl_fuzz}")
+
+    out_dir = Path(args.output)
+    out_dir.mkdir(parents=True, exist_ok=True)
+    env = os.environ.copy()
+    env["AFL_NO_UI"] = "1"
+
+    formats = list(dict.fromkeys(fmt for _, _, fmt in variants))
+    if jobs < len(formats):
+        sys.exit(f"[!] {len(formats)} input formats need at least {len(formats)} instances")
+    plan = []
+    has_main = set()
+    for idx in range(jobs):
+        if idx < len(formats):
+            # One instance per format first, so every sync dir gets its -M
+            name, binary, fmt = next(v for v in variants if v[2] == formats[idx])
+        else:
+            name, binary, fmt = variants[idx % len(variants)]
+        role = "-S" if fmt in has_main else "-M"
+        has_main.add(fmt)
+        instance = f"{name}-{idx}"
+        cmd = [args.afl_fuzz, "-i", seeds.get(fmt, seeds.get(None)), "-o", str(out_dir / fmt), role, instance,
+               "-b", str(cores[idx]), *args.afl_args.split(), "--", binary]
+        plan.append((f"{fmt}/{instance}", name, cmd))
+
+    print(f"[*] {jobs} instances on cores {cores[:jobs]}, variants: {', '.join(n for n, _, _ in variants)}, "
+          f"sync dirs: {', '.join(str(out_dir / f) for f in formats)}")
+    if args.dry_run:
+        for _, _, cmd in plan:
+            print("    " + " ".join(cmd))
+        return
+
+    procs = []
+    for instance, _, cmd in plan:
+        (out_dir / instance).parent.mkdir(parents=True, exist_ok=True)
+        log = open(out_dir / f"{instance}.log", "wb")
+        procs.append(subprocess.Popen(cmd, stdout=log, stderr=subprocess.STDOUT, env=env))
+        print(f"    started {instance} (pid {procs[-1].pid})")
+
+    def stop(*_):
+        for proc in procs:
+            if proc.poll() is None:
+                proc.send_signal(signal.SIGINT)
+        for proc in procs:
+            try:
+                proc.wait(timeout=30)
+            except subprocess.TimeoutExpired:
+                proc.kill()
+
+    signal.signal(signal.SIGTERM, lambda *_: sys.exit(0))
+    variant_of = {instance: name for instance, name, _ in plan}
+    start = time.time()
+    try:
+        while any(proc.poll() is None for proc in procs):
+            time.sleep(args.interval)
+            show_status(out_dir, variant_of)
+            for (instance, _, _), proc in zip(plan, procs):
+                if proc.returncode not in (None, 0):
+                    print(f"[!] {instance} exited with {proc.returncode}; see {out_dir / (instance + '.log')}")
+            if args.duration and time.time() - start >= args.duration:
+                break
+    except KeyboardInterrupt:
+        pass
+    finally:
+        print("[*] Stopping instances...")
+        stop()
+        show_status(out_dir, variant_of)
+
+
+if __name__ == "__main__":
+    main()
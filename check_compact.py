@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+"""Check that `encoder --compact` is decode-equivalent on a whole queue.
+
+Converts QUEUE with encoder --compact, then replays every converted
+testcase through main5.cpp and its original queue entry through main2.cpp
+(both echo builds), and compares the output testcase by testcase. Exits 1
+on the first mismatch, printing both outputs. --random N adds N seeded
+random testcases to the queue (default 500), half of them chains of
+one-child containers that end at ENCODER_MAX_DEPTH. Real queues rarely
+end inside a container at a limit, and that is where the two layouts can
+differ.
+
+    g++ -O2 -std=c++17 -pthread main2.cpp -ljsoncpp -o jsoncpp_fuzz2
+    g++ -O2 -std=c++17 main5.cpp -ljsoncpp -o jsoncpp_compact
+    g++ -O2 -std=c++17 -pthread encoder.cpp -ljsoncpp -o encoder
+    python3 check_compact.py out2/default/queue
+"""
+
+import argparse
+import random
+import shutil
+import subprocess
+import sys
+import tempfile
+from pathlib import Path
+
+
+def replay_each(binary, paths):
+    """Echo output of every path, one process per input (outputs have no separator)."""
+    outputs = []
+    for path in paths:
+        result = subprocess.run([binary, str(path)], stdin=subprocess.DEVNULL, capture_output=True)
+        if result.returncode != 0:
+            sys.exit(f"[!] {binary} {path} exited with {result.returncode}")
+        outputs.append(result.stdout)
+    return outputs
+
+
+def main():
+    parser = argparse.ArgumentParser(description="encoder --compact round-trip check")
+    parser.add_argument("queue", nargs="?", default="out2/default/queue", help="main2.cpp queue directory")
+    parser.add_argument("--main2", default="./jsoncpp_fuzz2", help="main2.cpp echo build")
+    parser.add_argument("--main5", default="./jsoncpp_compact", help="main5.cpp echo build")
+    parser.add_argument("--encoder", default="./encoder", help="encoder.cpp build")
+    parser.add_argument("--random", type=int, default=500, help="Random testcases added to the queue")
+    parser.add_argument("--seed", type=int, default=0, help="Seed for --random")
+    args = parser.parse_args()
+
+    for binary in (args.main2, args.main5, args.encoder):
+        if not Path(binary).is_file():
+            sys.exit(f"[!] Not found: {binary}")
+    with tempfile.TemporaryDirectory() as work:
+        queue_dir = Path(work) / "queue"
+        shutil.copytree(args.queue, queue_dir)
+        rng = random.Random(args.seed)
+        # Half are random bytes, mostly arrays and objects (value bytes
+        # 0xb8-0xbf, 0xc0-0xc7). The rest are chains of one-child containers
+        # (0xb9, or 0xc1 and a key byte) that reach the depth limit where the
+        # input ends, so nothing but limit nulls follows.
+        pool = bytes(range(0xb8, 0xc8)) * 4 + bytes(range(256))
+        for k in range(args.random):
+            if k % 2:
+                body = bytes(rng.choice(pool) for _ in range(rng.randrange(1, 48)))
+            else:
+                body = b""
+                for _ in range(rng.randrange(6, 12)):
+                    body += bytes([0xb9]) if rng.random() < 0.5 else bytes([0xc1, rng.randrange(256)])
+                body += bytes([rng.randrange(0xb8, 0xc8)])
+            (queue_dir / f"random:{k:06d}").write_bytes(bytes(rng.randrange(256) for _ in range(2)) + body)
+
+        queue = sorted(p for p in queue_dir.iterdir() if p.is_file() and not p.name.startswith("."))
+        # encoder --compact names its outputs like this, keeping the first of
+        # several queue entries that convert to the same bytes
+        by_name = {p.name.replace(":", "_"): p for p in queue}
+        out = Path(work) / "compact"
+        subprocess.run([args.encoder, "--compact", str(queue_dir), str(out)], check=True,
+                       stdout=subprocess.DEVNULL)
+        converted = sorted(Path(out).iterdir())
+        originals = [by_name[c.name] for c in converted]
+        print(f"[*] {len(queue) - args.random} queue entries + {args.random} random, "
+              f"{len(converted)} distinct compact testcases")
+        expected = replay_each(args.main2, originals)
+        actual = replay_each(args.main5, converted)
+
+    for original, want, got in zip(originals, expected, actual):
+        if want[2:] != got[2:]:  # the option bytes may differ in unused bits
+            print(f"[!] {original.name} decodes differently after conversion")
+            print(f"    main2: {want[2:]!r}")
+            print(f"    main5: {got[2:]!r}")
+            sys.exit(1)
+    print(f"[+] All {len(converted)} testcases decode to the same JSON under main2.cpp and main5.cpp")
+
+
+if __name__ == "__main__":
+    main()
@@ -17,6 +17,8 @@ HARNESS_BIN="$ROOT/jsoncpp_fuzz_cov"    # coverage build of harness
 
 AFL_OUT_DIR="$ROOT/out2/default"         # AFL++ -o out  => out/default/...
 QUEUE_DIR="$AFL_OUT_DIR/queue"
+# Replayed instead of QUEUE_DIR when present (queue_archive.py pack)
+QUEUE_ARCHIVE="${QUEUE_ARCHIVE:-$AFL_OUT_DIR/queue.qar}"
 
 PROFRAW_DIR="$ROOT/profraw"
 PROFDATA_FILE="$ROOT/coverage.profdata"
@@ -28,6 +30,12 @@ CXX_COMPILER=clang++
 
 COV_FLAGS="-O0 -g -fprofile-instr-generate -fcoverage-mapping"
 
+# Replay parallelism: one worker per core, each flushing a .profraw every
+# SHARD_SIZE inputs. A crash ends the worker; its slice is resumed after the
+# crashing input (see replay_range), so only that input goes unmeasured.
+JOBS="${JOBS:-$(nproc)}"
+SHARD_SIZE="${SHARD_SIZE:-64}"
+
 #############################
 # 1) Build jsoncpp with coverage
 #############################
@@ -77,35 +85,116 @@ echo "[+] Built $HARNESS_BIN"
 # 3) Replay AFL++ corpus (stdin harness)
 #############################
 
-if [[ ! -d "$QUEUE_DIR" ]]; then
-  echo "[!] AFL++ queue directory not found:"
-  echo "    $QUEUE_DIR"
-  echo "    Make sure you fuzzed with: afl-fuzz -i in -o out -- ./jsoncpp_fuzz"
-  exit 1
+if [[ -f "$QUEUE_ARCHIVE" ]]; then
+  echo "[*] Replaying AFL++ corpus from: $QUEUE_ARCHIVE"
+  num_inputs=$(python3 "$ROOT/queue_archive.py" count "$QUEUE_ARCHIVE")
+else
+  if [[ ! -d "$QUEUE_DIR" ]]; then
+    echo "[!] AFL++ queue directory not found:"
+    echo "    $QUEUE_DIR"
+    echo "    Make sure you fuzzed with: afl-fuzz -i in -o out -- ./jsoncpp_fuzz"
+    exit 1
+  fi
+  echo "[*] Replaying AFL++ corpus from: $QUEUE_DIR"
+  shopt -s nullglob
+  inputs=( "$QUEUE_DIR"/id:* )
+  num_inputs=${#inputs[@]}
 fi
 
-echo "[*] Replaying AFL++ corpus from: $QUEUE_DIR"
-
 rm -rf "$PROFRAW_DIR"
 mkdir -p "$PROFRAW_DIR"
 
-shopt -s nullglob
-inputs=( "$QUEUE_DIR"/id:* )
-
-if (( ${#inputs[@]} == 0 )); then
+if (( num_inputs == 0 )); then
   echo "[!] No inputs found in $QUEUE_DIR"
   exit 1
 fi
 
-# Harness reads from stdin and can process multiple inputs per run,
-# but here we just feed one input per run via stdin and let it exit on EOF.
-for f in "${inputs[@]}"; do
-  echo "    -> $f"
-  LLVM_PROFILE_FILE="$PROFRAW_DIR/%p.profraw" \
-    "$HARNESS_BIN" < "$f" >/dev/null 2>&1 || true
+# Split the queue into one contiguous slice per worker. Each worker replays
+# its slice in-process (harness --replay) and writes
+# $PROFRAW_DIR/<index>.profraw once per shard instead of once per input.
+# An archive slice is one ARCHIVE#BEGIN-END argument instead of a file list.
+per_worker=$(( (num_inputs + JOBS - 1) / JOBS ))
+echo "    $num_inputs inputs, $JOBS workers, shards of $SHARD_SIZE"
+
+CRASH_LOG="$PROFRAW_DIR/crashes.txt"       # one crashing input index per line
+FLUSH_LOG="$PROFRAW_DIR/missing-shards.txt"
+
+profraw_of() { printf '%s/%06d.profraw' "$PROFRAW_DIR" "$1"; }
+
+# Replays inputs [begin, end) in one process, a .profraw every $3 inputs.
+replay_run() {
+  local begin=$1 end=$2 size=$3 slice
+  if [[ -f "$QUEUE_ARCHIVE" ]]; then
+    slice=( "$QUEUE_ARCHIVE#$begin-$end" )
+  else
+    slice=( "${inputs[@]:begin:end - begin}" )
+  fi
+  LLVM_PROFILE_FILE="$PROFRAW_DIR/worker-%p.profraw" \
+    "$HARNESS_BIN" --replay \
+      --profile-dir "$PROFRAW_DIR" \
+      --shard-size "$size" \
+      --index-base "$begin" \
+      "${slice[@]}" >/dev/null 2>&1
+}
+
+# Replays [begin, end) in shards of $3 and, like plot_coverage_fast.py, goes
+# on past a crash: the shard without a .profraw is replayed one input per
+# profile to find the crashing input, and the slice resumes after it. So a
+# crash only loses that one input, as with one process per input.
+replay_range() {
+  local begin=$1 end=$2 size=$3 done shard_end k
+  while (( begin < end )); do
+    if replay_run "$begin" "$end" "$size"; then
+      for (( k = begin; k < end; k += size )); do
+        [[ -f "$(profraw_of "$k")" ]] || echo "$k" >> "$FLUSH_LOG"
+      done
+      return 0
+    fi
+    done=$begin
+    while (( done < end )) && [[ -f "$(profraw_of "$done")" ]]; do
+      done=$(( done + size ))
+    done
+    (( done < end )) || return 0
+    if (( size > 1 )); then
+      shard_end=$(( done + size < end ? done + size : end ))
+      replay_range "$done" "$shard_end" 1
+      begin=$shard_end
+    else
+      echo "    [!] input $done crashed the harness; resuming after it"
+      echo "$done" >> "$CRASH_LOG"
+      begin=$(( done + 1 ))
+    fi
+  done
+}
+
+pids=()
+for (( start = 0; start < num_inputs; start += per_worker )); do
+  end=$(( start + per_worker < num_inputs ? start + per_worker : num_inputs ))
+  # stderr: only the shell's "Aborted" notes for crashed runs
+  replay_range "$start" "$end" "$SHARD_SIZE" 2>/dev/null &
+  pids+=( "$!" )
+done
+for pid in "${pids[@]}"; do
+  wait "$pid"
 done
 
-echo "[+] Collected raw profiles in $PROFRAW_DIR"
+# A run that exits 0 must have flushed every shard. A worker-<pid>.profraw
+# is the runtime's at-exit write, which only happens when --profile-dir was
+# ignored (a build without -fprofile-instr-generate).
+shopt -s nullglob
+strays=( "$PROFRAW_DIR"/worker-*.profraw )
+if [[ -f "$FLUSH_LOG" ]] || (( ${#strays[@]} > 0 )); then
+  echo "[!] $(cat "$FLUSH_LOG" 2>/dev/null | wc -l) shard profiles missing after clean exits," \
+       "${#strays[@]} at-exit profiles in $PROFRAW_DIR"
+  echo "    The per-shard flush is broken; is $HARNESS_BIN a coverage build?"
+  exit 1
+fi
+
+profiles=( "$PROFRAW_DIR"/[0-9]*.profraw )
+echo "[+] Collected ${#profiles[@]} profiles for $num_inputs inputs in $PROFRAW_DIR"
+if [[ -f "$CRASH_LOG" ]]; then
+  echo "    $(wc -l < "$CRASH_LOG") crashing inputs have no profile; their indexes are in $CRASH_LOG"
+fi
 
 #############################
 # 4) Merge & report coverage
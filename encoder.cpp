@@ -0,0 +1,154 @@
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include <cstdint>
+#include <sys/stat.h>
+#define HARNESS_NO_MAIN
+#include "harness.h"
+#include "json_encoder.h"
+#include "token_weights.h"
+
+// Turns encoder input (main2.cpp's testcase layout: A,B then documents
+// framed by HARNESS_FRAMING) into main.cpp input: A,B then one generated JSON
+// document per line. Used by seed.py to build seed corpora from a queue.
+//
+//   encoder < TESTCASE                     transcode stdin to stdout
+//   encoder --batch QUEUE_DIR OUT_DIR [-j N]
+//                                          transcode every file in QUEUE_DIR
+//                                          on N threads (default: all cores),
+//                                          dropping identical outputs
+//   encoder --compact QUEUE_DIR OUT_DIR [-j N]
+//                                          the same, but convert to main5.cpp
+//                                          testcases (compact v1 layout) that
+//                                          produce the same JSON
+//
+// Build:
+//   g++ -O2 -std=c++17 -pthread encoder.cpp -ljsoncpp -o encoder
+
+// Same bytes main2.cpp echoes for the testcase; empty if it has no A,B.
+static void transcode(const uint8_t *data, size_t size, std::string &out) {
+    out.clear();
+    if (size < 2)
+        return;
+    out.append(reinterpret_cast<const char *>(data), 2);  // A,B
+
+    thread_local char arena[JsonEncoder::outputBound(ENCODER_MAX_NODES)];
+
+    const char *text = reinterpret_cast<const char *>(data);
+    harness::forEachDocument(text + 2, text + size, [&](const char *p, const char *docEnd) {
+        JsonEncoder enc(reinterpret_cast<const uint8_t *>(p), docEnd - p,
+                        ENCODER_MAX_DEPTH, ENCODER_MAX_NODES);
+        std::string_view json = enc.encodeIterativeInto(arena);
+        out.append(json.data(), json.size());
+        out.push_back('\n');
+        return enc.consumed();
+    });
+}
+
+// main2.cpp testcase -> main5.cpp testcase with the same documents; empty
+// if it has no A,B. The header spells out this build's limits.
+static void compact(const uint8_t *data, size_t size, std::string &out) {
+    out.clear();
+    if (size < 2)
+        return;
+    json_format::appendHeader(out, {harness::optionMask(data[0], data[1]),
+                                    static_cast<uint32_t>(ENCODER_MAX_DEPTH),
+                                    static_cast<uint32_t>(ENCODER_MAX_NODES)});
+
+    const char *text = reinterpret_cast<const char *>(data);
+    harness::forEachDocument(text + 2, text + size, [&](const char *p, const char *docEnd) {
+        JsonEncoder enc(reinterpret_cast<const uint8_t *>(p), docEnd - p,
+                        ENCODER_MAX_DEPTH, ENCODER_MAX_NODES);
+        enc.toCompact(out);
+        return enc.consumed();
+    });
+}
+
+static void runTestcase(const uint8_t *data, size_t size) {
+    static std::string out;
+    transcode(data, size, out);
+    harness::echo(out);
+}
+
+// Queue names contain ':', which some filesystems and tools dislike.
+static std::string seedName(const std::string &path) {
+    std::string name = harness::inputName(path);
+    for (char &c : name) {
+        if (c == ':')
+            c = '_';
+    }
+    return name;
+}
+
+using Convert = void (*)(const uint8_t *data, size_t size, std::string &out);
+
+static int batchMain(int argc, char **argv, Convert convert) {
+    if (argc < 4) {
+        std::fprintf(stderr, "usage: %s %s QUEUE_DIR|ARCHIVE.qar OUT_DIR [-j N]\n", argv[0], argv[1]);
+        return 1;
+    }
+    const std::string outDir = argv[3];
+    unsigned jobs = std::thread::hardware_concurrency();
+    if (argc > 5 && std::strcmp(argv[4], "-j") == 0)
+        jobs = static_cast<unsigned>(std::strtoul(argv[5], nullptr, 10));
+    jobs = harness::usableJobs(jobs);
+
+    std::vector<std::string> paths = harness::collectInputs(argv + 2, argv + 3);
+    std::vector<std::string> outputs(paths.size());
+    std::vector<size_t> inputSizes(paths.size());
+    harness::parallelFor(paths.size(), jobs, [&](size_t i) {
+        harness::Input input;
+        if (!input.open(paths[i].c_str())) {
+            std::fprintf(stderr, "[encoder] cannot open %s: %s\n", paths[i].c_str(), std::strerror(errno));
+            return;
+        }
+        inputSizes[i] = input.size();
+        convert(input.data(), input.size(), outputs[i]);
+    });
+
+    // Keep the first (oldest) queue entry of every distinct output
+    std::unordered_set<std::string_view> seen;
+    std::vector<size_t> unique;
+    for (size_t i = 0; i < outputs.size(); ++i) {
+        if (!outputs[i].empty() && seen.insert(outputs[i]).second)
+            unique.push_back(i);
+    }
+
+    if (mkdir(outDir.c_str(), 0755) != 0 && errno != EEXIST) {
+        std::fprintf(stderr, "[encoder] cannot create %s: %s\n", outDir.c_str(), std::strerror(errno));
+        return 1;
+    }
+    std::atomic<size_t> failed{0};
+    harness::parallelFor(unique.size(), jobs, [&](size_t u) {
+        size_t i = unique[u];
+        std::string path = outDir + "/" + seedName(paths[i]);
+        FILE *f = std::fopen(path.c_str(), "wb");
+        if (!f || std::fwrite(outputs[i].data(), 1, outputs[i].size(), f) != outputs[i].size()) {
+            std::fprintf(stderr, "[encoder] cannot write %s: %s\n", path.c_str(), std::strerror(errno));
+            ++failed;
+        }
+        if (f)
+            std::fclose(f);
+    });
+
+    size_t inBytes = 0, outBytes = 0;
+    for (size_t size : inputSizes)
+        inBytes += size;
+    for (size_t i : unique)
+        outBytes += outputs[i].size();
+    std::printf("Encoded %zu queue entries (%zu bytes) into %zu unique seeds (%zu bytes) under %s\n",
+                paths.size(), inBytes, unique.size() - failed, outBytes, outDir.c_str());
+    return failed ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+    harness::loadTokenWeights();  // must match the weights the queue was fuzzed with
+    if (argc > 1 && std::strcmp(argv[1], "--batch") == 0)
+        return batchMain(argc, argv, transcode);
+    if (argc > 1 && std::strcmp(argv[1], "--compact") == 0)
+        return batchMain(argc, argv, compact);
+    return harness::runMain(argc, argv);
+}
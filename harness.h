@@ -0,0 +1,1514 @@
+// Shared driver for the jsoncpp harnesses (main.cpp, main2.cpp, main3.cpp).
+//
+// A harness defines
+//     static void runTestcase(const uint8_t *data, size_t size);
+// with the body for one testcase, and this header supplies every entry point
+// that calls it:
+//   - LLVMFuzzerTestOneInput for libFuzzer, honggfuzz and AFL++'s libFuzzer
+//     driver. Build with -DHARNESS_LIBFUZZER so the fuzzer provides main().
+//   - main() running AFL++ persistent mode from shared memory when built
+//     with afl-clang-fast, or reading all of stdin as one testcase otherwise.
+//     `harness FILE` runs FILE as the testcase instead (AFL++ @@ style).
+//   - `harness --replay [options] PATH...` runs many testcases in one
+//     process, for coverage replay (see replayMain below).
+//   - `harness --minimize OUT_DIR PATH...` keeps a coverage-preserving
+//     subset of a corpus (see minimizeMain below).
+//   - `harness --profile-replay K [options] PATH...` times every testcase
+//     over K runs and reports the slowest (see profileReplayMain below).
+//   - `harness --tmin IN OUT` shrinks a crashing testcase token by token,
+//     in harnesses that define HARNESS_TMIN (see harness_tmin.h).
+//   - `harness --batch [-j N] [-o FILE] PATH...` parses a corpus on all
+//     cores and writes one verdict per input, in harnesses that define
+//     HARNESS_BATCH and evaluateTestcase (see batchMain below).
+// Define HARNESS_NO_MAIN to write main() yourself (it can still hand off to
+// harness::runMain), as encoder.cpp does for its extra modes.
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <ctime>
+#include <unordered_set>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <jsoncpp/json/json.h>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+#include "harness_cov.h"
+#include "harness_profile.h"
+#include "harness_roundtrip.h"
+#include "harness_snapshot.h"
+#include "queue_archive.h"
+#if defined(HARNESS_VALUE_ARENA) || defined(HARNESS_COUNT_ALLOCS)
+#include "harness_alloc.h"
+#endif
+
+// Number of testcases one persistent-mode process handles before AFL++
+// restarts it.
+#ifndef AFL_LOOP_COUNT
+#define AFL_LOOP_COUNT 10000
+#endif
+
+// afl-clang-fast defines __AFL_FUZZ_TESTCASE_LEN; in that build the testcase
+// is read straight from shared memory instead of stdin.
+#if defined(__AFL_FUZZ_TESTCASE_LEN) && !defined(HARNESS_LIBFUZZER)
+#define HARNESS_AFL_PERSISTENT 1
+__AFL_FUZZ_INIT();
+#endif
+
+// Console output (main.cpp's OK/ERR lines, main2.cpp's generated JSON) is
+// off by default in fuzzing builds, where nobody reads it and the write
+// costs more than a small parse. Override with -DHARNESS_ECHO=0/1.
+#ifndef HARNESS_ECHO
+#if defined(__AFL_COMPILER) || defined(HARNESS_LIBFUZZER)
+#define HARNESS_ECHO 0
+#else
+#define HARNESS_ECHO 1
+#endif
+#endif
+
+static void runTestcase(const uint8_t *data, size_t size);
+
+// --batch: the same parse as runTestcase, but only reporting the outcome,
+// and safe to run on many threads at once: no statics, no echo, readers
+// from the calling worker's cache.
+namespace harness {
+class ReaderCache;
+struct Outcome;
+struct Shape;
+}
+#ifdef HARNESS_BATCH
+static harness::Outcome evaluateTestcase(const uint8_t *data, size_t size, harness::ReaderCache &readers);
+#endif
+
+// --profile-replay: what a testcase asks of the parser (its option mask,
+// documents, encoder nodes and depth), so slow inputs can be told apart.
+#ifdef HARNESS_SHAPE
+static harness::Shape testcaseShape(const uint8_t *data, size_t size);
+#endif
+
+// --tmin: the harness's own minimizer entry point (see harness_tmin.h).
+#ifdef HARNESS_TMIN
+static int tminMain(int argc, char **argv);
+#endif
+
+// LLVM profile runtime, linked only into -fprofile-instr-generate builds.
+extern "C" {
+int __llvm_profile_write_file(void) __attribute__((weak));
+int __llvm_profile_dump(void) __attribute__((weak));
+void __llvm_profile_reset_counters(void) __attribute__((weak));
+void __llvm_profile_set_filename(const char *name) __attribute__((weak));
+char *__llvm_profile_begin_counters(void) __attribute__((weak));
+char *__llvm_profile_end_counters(void) __attribute__((weak));
+}
+
+namespace harness {
+
+static constexpr bool kEcho = HARNESS_ECHO != 0;
+
+// Buffered write to stdout; compiled out when HARNESS_ECHO is 0.
+inline void echo(const char *data, size_t size) {
+    if (kEcho) {
+        StageTimer timer(Stage::Echo);
+        timer.bytesOut(size);
+        std::fwrite(data, 1, size, stdout);
+    }
+}
+
+inline void echo(std::string_view text) {
+    echo(text.data(), text.size());
+}
+
+// A whole testcase in memory: regular files are mmapped, anything else
+// (pipes, terminals) is drained with read(2) into an owned buffer.
+class Input {
+public:
+    Input() = default;
+    Input(const Input &) = delete;
+    Input &operator=(const Input &) = delete;
+
+    ~Input() {
+        release();
+    }
+
+    // Maps or reads path, or points at an archive member (ARCHIVE.qar#INDEX,
+    // see queue_archive.h) without copying it; false (with errno set) if it
+    // cannot be opened.
+    bool open(const char *path) {
+        StageTimer timer(Stage::Load);
+        size_t index;
+        if (const QueueArchive *archive = archiveMember(path, index)) {
+            release();
+            data_ = archive->data(index);
+            size_ = archive->size(index);
+            timer.bytesOut(size_);
+            return true;
+        }
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+            return false;
+        bool ok = load(fd);
+        ::close(fd);
+        timer.bytesOut(size_);
+        return ok;
+    }
+
+    bool load(int fd) {
+        release();
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+            if (st.st_size == 0)
+                return true;
+            int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+            flags |= MAP_POPULATE;
+#endif
+            void *p = mmap(nullptr, st.st_size, PROT_READ, flags, fd, 0);
+            if (p != MAP_FAILED) {
+                mapped_ = p;
+                data_ = static_cast<const uint8_t *>(p);
+                size_ = st.st_size;
+                return true;
+            }
+        }
+        buffer_.resize(1 << 16);
+        size_t used = 0;
+        for (;;) {
+            if (used == buffer_.size())
+                buffer_.resize(buffer_.size() * 2);
+            ssize_t n = ::read(fd, buffer_.data() + used, buffer_.size() - used);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                break;
+            used += n;
+        }
+        data_ = buffer_.data();
+        size_ = used;
+        return true;
+    }
+
+    const uint8_t *data() const {
+        return data_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+private:
+    void release() {
+        if (mapped_)
+            munmap(mapped_, size_);
+        mapped_ = nullptr;
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    void *mapped_ = nullptr;
+    const uint8_t *data_ = nullptr;
+    size_t size_ = 0;
+    std::vector<uint8_t> buffer_;
+};
+
+// The 11 CharReaderBuilder options carried by the A,B header bytes:
+// all of A in bits 0..7, the low three bits of B in bits 8..10.
+static constexpr unsigned kNumOptionBits = 11;
+
+inline unsigned optionMask(uint8_t A, uint8_t B) {
+    return A | ((B & 0x7u) << 8);
+}
+
+// Setting switched on by each mask bit, lowest first.
+static constexpr const char *kOptionNames[kNumOptionBits] = {
+    "collectComments", "allowComments", "allowTrailingCommas", "strictRoot",
+    "allowDroppedNullPlaceholders", "allowNumericKeys", "allowSingleQuotes",
+    "failIfExtra", "rejectDupKeys", "allowSpecialFloats", "skipBom",
+};
+
+// Option sets for main3.cpp's fixed-mask builds (HARNESS_OPTIONS).
+static constexpr unsigned kAllOptions = (1u << kNumOptionBits) - 1;
+static constexpr unsigned kStrictRootOption = 1u << 3;
+// main3.cpp's original reader: every option on except strictRoot, so the
+// scalar roots most encoder documents have still parse past the root check
+static constexpr unsigned kScalarRootOptions = kAllOptions & ~kStrictRootOption;
+static_assert(kScalarRootOptions == 0x7f7, "strictRoot is bit 3");
+// CharReaderBuilder::strictMode(): strictRoot, failIfExtra, rejectDupKeys,
+// skipBom
+static constexpr unsigned kStrictOptions = 0x588;
+// Every leniency except comments: trailing commas, dropped nulls, numeric
+// keys, single quotes, special floats, BOM skipping
+static constexpr unsigned kPermissiveOptions = 0x674;
+// collectComments and allowComments
+static constexpr unsigned kCommentOptions = 0x3;
+
+inline void applyOptionMask(Json::CharReaderBuilder &builder, unsigned mask) {
+    for (unsigned bit = 0; bit < kNumOptionBits; ++bit)
+        builder[kOptionNames[bit]] = (mask >> bit & 1) != 0;
+}
+
+// Statistics are printed to stderr at exit when HARNESS_STATS is set.
+inline bool statsEnabled() {
+    static const bool enabled = std::getenv("HARNESS_STATS") != nullptr;
+    return enabled;
+}
+
+// One CharReader per option mask, built on first use and reused for every
+// later document with the same mask, so a parse no longer pays for
+// newCharReader()'s allocation, settings copy and validation.
+// -DHARNESS_NO_READER_CACHE builds a fresh reader per document instead,
+// the old behaviour, for comparing exec speed.
+class ReaderCache {
+public:
+    static constexpr unsigned kNumMasks = 1u << kNumOptionBits;
+
+    ReaderCache() = default;
+    ReaderCache(const ReaderCache &) = delete;
+    ReaderCache &operator=(const ReaderCache &) = delete;
+
+    ~ReaderCache() {
+        if (statsEnabled())
+            report();
+    }
+
+    // Builds the reader for every mask up front, so a forkserver or
+    // persistent-mode process never builds one on the exec path.
+    // A harness that only ever uses one mask defines HARNESS_FIXED_MASK.
+    void prebuild() {
+#ifndef HARNESS_NO_READER_CACHE
+#ifdef HARNESS_FIXED_MASK
+        if (!readers_[HARNESS_FIXED_MASK])
+            get(HARNESS_FIXED_MASK);
+#else
+        for (unsigned mask = 0; mask < kNumMasks; ++mask) {
+            if (!readers_[mask])
+                get(mask);
+        }
+#endif
+        hits_ = 0;
+#endif
+    }
+
+    Json::CharReader &get(unsigned mask) {
+        mask &= kNumMasks - 1;
+        std::unique_ptr<Json::CharReader> &slot = readers_[mask];
+#ifndef HARNESS_NO_READER_CACHE
+        if (slot) {
+            ++hits_;
+            return *slot;
+        }
+#endif
+        StageTimer timer(Stage::Build);
+        auto start = std::chrono::steady_clock::now();
+        applyOptionMask(builder_, mask);
+        slot.reset(builder_.newCharReader());
+        buildNs_ += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - start).count();
+        ++builds_;
+        return *slot;
+    }
+
+    void report() {
+        double perBuildUs = builds_ ? buildNs_ / 1e3 / builds_ : 0.0;
+#ifndef HARNESS_NO_READER_CACHE
+        // The first builds run cold, so price a hit with a few warm builds
+        // done here, off the exec path.
+        constexpr int kCalibrationBuilds = 32;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kCalibrationBuilds; ++i)
+            std::unique_ptr<Json::CharReader>(builder_.newCharReader());
+        double warmUs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now() - start).count() /
+                        1e3 / kCalibrationBuilds;
+        std::fprintf(stderr,
+                     "[harness] reader cache: %llu builds (%.2f us each), "
+                     "%llu hits, ~%.3f ms of exec time saved at %.2f us/build\n",
+                     static_cast<unsigned long long>(builds_), perBuildUs,
+                     static_cast<unsigned long long>(hits_),
+                     hits_ * warmUs / 1e3, warmUs);
+#else
+        std::fprintf(stderr,
+                     "[harness] reader cache disabled: %llu builds, "
+                     "%.2f us/build, %.3f ms spent building readers\n",
+                     static_cast<unsigned long long>(builds_), perBuildUs,
+                     buildNs_ / 1e6);
+#endif
+    }
+
+private:
+    Json::CharReaderBuilder builder_;
+    std::unique_ptr<Json::CharReader> readers_[kNumMasks];
+    uint64_t builds_ = 0;
+    uint64_t hits_ = 0;
+    uint64_t buildNs_ = 0;
+};
+
+inline ReaderCache &readerCache() {
+    static ReaderCache cache;
+    return cache;
+}
+
+// The Json::Value one document is parsed into: a fresh local by default.
+// -DHARNESS_VALUE_ARENA recycles a single root per process instead and
+// serves every operator new made while a ParseRoot is alive (the tree's
+// map nodes and std::strings, the error text) from the value arena in
+// harness_alloc.h. Resetting the root at the end hands the whole tree back
+// in one go, and the next document bumps through the same chunks.
+class ParseRoot {
+public:
+    ParseRoot() = default;
+    ParseRoot(const ParseRoot &) = delete;
+    ParseRoot &operator=(const ParseRoot &) = delete;
+
+#ifdef HARNESS_VALUE_ARENA
+    ~ParseRoot() {
+        recycled() = Json::Value();
+    }
+
+    Json::Value &get() {
+        return recycled();
+    }
+
+private:
+    static Json::Value &recycled() {
+        static Json::Value root;
+        return root;
+    }
+
+    alloc::ArenaScope scope_;
+#else
+    Json::Value &get() {
+        return value_;
+    }
+
+private:
+    Json::Value value_;
+#endif
+};
+
+// Per option mask counters, kept when HARNESS_MASK_STATS=FILE is set and
+// appended to FILE as TSV at exit (one row per mask that ran, tagged with
+// the pid, so restarts of a persistent-mode process add up). In a coverage
+// build (harness_cov.h) each row also has the distinct edges the mask's
+// testcases reached in this process, "-" otherwise, and in every build the
+// distinct parser error messages they produced.
+class MaskStats {
+public:
+    static constexpr unsigned kNumMasks = ReaderCache::kNumMasks;
+
+    MaskStats() : path_(std::getenv("HARNESS_MASK_STATS")) {}
+    MaskStats(const MaskStats &) = delete;
+    MaskStats &operator=(const MaskStats &) = delete;
+
+    ~MaskStats() {
+        if (path_)
+            dump();
+    }
+
+    bool enabled() const {
+        return path_ != nullptr;
+    }
+
+    // Called by runTestcase once it knows the mask; endTestcase() then
+    // credits the exec's edges to it.
+    void testcase(unsigned mask) {
+        if (!path_)
+            return;
+        current_ = mask & (kNumMasks - 1);
+        ++counts_[current_].testcases;
+        resetCoverage();
+    }
+
+    void endTestcase() {
+        if (!path_ || current_ == kNoMask)
+            return;
+        std::vector<uint64_t> &seen = edges_[current_];
+        Counts &c = counts_[current_];
+        forEachEdge([&](uint32_t edge, uint8_t) {
+            if (edge / 64 >= seen.size())
+                seen.resize(edge / 64 + 1);
+            const uint64_t bit = uint64_t{1} << (edge % 64);
+            if (!(seen[edge / 64] & bit)) {
+                seen[edge / 64] |= bit;
+                ++c.edges;
+            }
+        });
+        current_ = kNoMask;
+    }
+
+    void document(unsigned mask, bool ok, const std::string &errs) {
+        if (!path_)
+            return;
+        mask &= kNumMasks - 1;
+        Counts &c = counts_[mask];
+        ++(ok ? c.ok : c.failed);
+        if (!ok) {
+            uint64_t key = (static_cast<uint64_t>(mask) << 48) ^
+                           (std::hash<std::string>()(errs) & 0xffffffffffffULL);
+            if (errors_.insert(key).second)
+                ++c.distinctErrors;
+        }
+    }
+
+    void dump() const {
+        FILE *f = std::fopen(path_, "a");
+        if (!f) {
+            std::fprintf(stderr, "[harness] cannot write %s: %s\n", path_, std::strerror(errno));
+            return;
+        }
+        if (std::ftell(f) == 0)
+            std::fprintf(f, "pid\tmask\ttestcases\tok\tfailed\tedges\tdistinct_errors\n");
+        for (unsigned mask = 0; mask < kNumMasks; ++mask) {
+            const Counts &c = counts_[mask];
+            if (c.testcases == 0 && c.ok == 0 && c.failed == 0)
+                continue;
+            char edges[24] = "-";
+            if (coverageAvailable())
+                std::snprintf(edges, sizeof(edges), "%llu", static_cast<unsigned long long>(c.edges));
+            std::fprintf(f, "%d\t0x%03x\t%llu\t%llu\t%llu\t%s\t%llu\n", static_cast<int>(getpid()), mask,
+                         static_cast<unsigned long long>(c.testcases),
+                         static_cast<unsigned long long>(c.ok),
+                         static_cast<unsigned long long>(c.failed), edges,
+                         static_cast<unsigned long long>(c.distinctErrors));
+        }
+        std::fclose(f);
+    }
+
+private:
+    struct Counts {
+        uint64_t testcases = 0;
+        uint64_t ok = 0;
+        uint64_t failed = 0;
+        uint64_t edges = 0;
+        uint64_t distinctErrors = 0;
+    };
+    static constexpr unsigned kNoMask = kNumMasks;
+
+    const char *path_;
+    unsigned current_ = kNoMask;
+    Counts counts_[kNumMasks];
+    std::vector<uint64_t> edges_[kNumMasks];  // bitset of edges seen per mask
+    std::unordered_set<uint64_t> errors_;  // mask << 48 ^ message hash
+};
+
+inline MaskStats &maskStats() {
+    static MaskStats stats;
+    return stats;
+}
+
+// Runs one testcase, timed as Stage::Exec, and writes the stage profile if
+// one was asked for (SIGUSR1) meanwhile.
+inline void execute(const uint8_t *data, size_t size) {
+    {
+        StageTimer timer(Stage::Exec, size);
+        runTestcase(data, size);
+    }
+    maskStats().endTestcase();      // HARNESS_MASK_STATS
+    coverageSnapshot().update();    // HARNESS_COV_SNAPSHOT
+    profilePoll();
+}
+
+struct Span {
+    const char *begin;
+    const char *end;
+};
+
+// Calls onLine(begin, end) for every non-empty '\n' separated line of
+// [p, end), including a last line without a trailing newline. Each step
+// compares 64 bytes (two AVX2 or four SSE2 registers; 16 with NEON) and
+// walks the newline bitmask, so short lines cost no memchr call each.
+template <class OnLine>
+inline void scanLines(const char *p, const char *end, OnLine onLine) {
+    const char *lineStart = p;
+    auto newline = [&](const char *nl) {
+        if (nl != lineStart)
+            onLine(lineStart, nl);
+        lineStart = nl + 1;
+    };
+#if defined(__AVX2__)
+    const __m256i nl = _mm256_set1_epi8('\n');
+    for (; end - p >= 64; p += 64) {
+        const __m256i *block = reinterpret_cast<const __m256i *>(p);
+        uint64_t lo = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(block), nl)));
+        uint64_t hi = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(block + 1), nl)));
+        for (uint64_t bits = lo | hi << 32; bits; bits &= bits - 1)
+            newline(p + __builtin_ctzll(bits));
+    }
+#elif defined(__SSE2__)
+    const __m128i nl = _mm_set1_epi8('\n');
+    for (; end - p >= 64; p += 64) {
+        const __m128i *block = reinterpret_cast<const __m128i *>(p);
+        uint64_t bits = 0;
+        for (int i = 0; i < 4; ++i) {
+            uint64_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(block + i), nl)));
+            bits |= mask << (16 * i);
+        }
+        for (; bits; bits &= bits - 1)
+            newline(p + __builtin_ctzll(bits));
+    }
+#elif defined(__ARM_NEON)
+    // No movemask: a narrowing shift packs the compare into 4 bits per byte
+    const uint8x16_t nl = vdupq_n_u8('\n');
+    for (; end - p >= 16; p += 16) {
+        uint8x16_t eq = vceqq_u8(vld1q_u8(reinterpret_cast<const uint8_t *>(p)), nl);
+        uint64_t bits = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+        for (; bits; bits &= ~(uint64_t{0xf} << (__builtin_ctzll(bits) & ~3)))
+            newline(p + (__builtin_ctzll(bits) >> 2));
+    }
+#else
+    // No known vector unit: the C library's memchr beats a byte loop
+    while (const char *nl = static_cast<const char *>(std::memchr(p, '\n', end - p))) {
+        newline(nl);
+        p = nl + 1;
+    }
+    p = end;
+#endif
+    for (; p < end; ++p) {
+        if (*p == '\n')
+            newline(p);
+    }
+    if (lineStart < end)
+        onLine(lineStart, end);
+}
+
+// Appends the lines of [p, end) to spans, as scanLines sees them.
+inline void splitLines(const char *p, const char *end, std::vector<Span> &spans) {
+    scanLines(p, end, [&](const char *begin, const char *lineEnd) {
+        spans.push_back(Span{begin, lineEnd});
+    });
+}
+
+// Calls fn(begin, end) for every non-empty '\n' separated line in
+// [p, end), including a last line without a trailing newline. Lines are
+// framed into a small span list first and then handed to fn a batch at a
+// time; a whole-testcase list would be slower than memchr once it no longer
+// fits in cache.
+template <class Fn>
+inline void forEachLine(const char *p, const char *end, Fn fn) {
+    constexpr size_t kBatch = 64;
+    Span batch[kBatch];
+    size_t n = 0;
+    scanLines(p, end, [&](const char *begin, const char *lineEnd) {
+        batch[n++] = Span{begin, lineEnd};
+        if (n == kBatch) {
+            for (size_t i = 0; i < n; ++i)
+                fn(batch[i].begin, batch[i].end);
+            n = 0;
+        }
+    });
+    for (size_t i = 0; i < n; ++i)
+        fn(batch[i].begin, batch[i].end);
+}
+
+// How the encoder harnesses split one testcase into documents:
+//   HARNESS_FRAMING_LINES   one encoder input per '\n' separated line (default)
+//   HARNESS_FRAMING_LENGTH  a length byte, then that many bytes of encoder
+//                           input, repeated
+//   HARNESS_FRAMING_STREAM  back-to-back encoder inputs with no framing
+//                           bytes; each document starts where the encoder
+//                           stopped reading the previous one
+// A testcase normally carries many documents, so one exec amortises process,
+// fork and coverage-map overhead over many parses.
+#define HARNESS_FRAMING_LINES 0
+#define HARNESS_FRAMING_LENGTH 1
+#define HARNESS_FRAMING_STREAM 2
+#ifndef HARNESS_FRAMING
+#define HARNESS_FRAMING HARNESS_FRAMING_LINES
+#endif
+
+// Calls fn(begin, end) for every document in [p, end) under HARNESS_FRAMING.
+// fn returns how many bytes of [begin, end) it consumed; only STREAM framing
+// uses that, to find where the next document starts.
+template <class Fn>
+inline void forEachDocument(const char *p, const char *end, Fn fn) {
+#if HARNESS_FRAMING == HARNESS_FRAMING_LINES
+    forEachLine(p, end, [&](const char *begin, const char *lineEnd) {
+        fn(begin, lineEnd);
+    });
+#elif HARNESS_FRAMING == HARNESS_FRAMING_LENGTH
+    while (p < end) {
+        size_t len = static_cast<uint8_t>(*p++);
+        if (len > static_cast<size_t>(end - p))
+            len = end - p;
+        if (len != 0)
+            fn(p, p + len);
+        p += len;
+    }
+#elif HARNESS_FRAMING == HARNESS_FRAMING_STREAM
+    while (p < end) {
+        size_t used = fn(p, end);
+        if (used == 0)
+            break;
+        p += used < static_cast<size_t>(end - p) ? used : end - p;
+    }
+#else
+#error "unknown HARNESS_FRAMING"
+#endif
+}
+
+// Testcase paths from the command line; a directory stands for its regular
+// files (dotfiles such as AFL++'s .state skipped) in name order, and a queue
+// archive or a range of one for its members (see appendMembers).
+inline std::vector<std::string> collectInputs(char **first, char **last) {
+    std::vector<std::string> paths;
+    for (char **arg = first; arg != last; ++arg) {
+        if (appendMembers(*arg, paths))
+            continue;
+        struct stat st;
+        if (stat(*arg, &st) != 0 || !S_ISDIR(st.st_mode)) {
+            paths.emplace_back(*arg);
+            continue;
+        }
+        std::vector<std::string> entries;
+        if (DIR *dir = opendir(*arg)) {
+            while (struct dirent *e = readdir(dir)) {
+                if (e->d_name[0] == '.')
+                    continue;
+                std::string path = std::string(*arg) + "/" + e->d_name;
+                if (stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode))
+                    entries.push_back(std::move(path));
+            }
+            closedir(dir);
+        }
+        std::sort(entries.begin(), entries.end());
+        paths.insert(paths.end(), entries.begin(), entries.end());
+    }
+    return paths;
+}
+
+// Writes the coverage counters gathered so far to DIR/<index>.profraw, where
+// index is the position of the shard's first input in the replay list.
+// The last shard is written with __llvm_profile_dump so the runtime's own
+// at-exit write does not overwrite it.
+inline void flushProfile(const std::string &dir, size_t index, bool last) {
+    static char name[4096];
+    std::snprintf(name, sizeof(name), "%s/%06zu.profraw", dir.c_str(), index);
+    __llvm_profile_set_filename(name);
+    if (last) {
+        __llvm_profile_dump();
+    } else {
+        __llvm_profile_write_file();
+        __llvm_profile_reset_counters();
+    }
+}
+
+// Writes which profile counters the last input hit to DIR/<index>.bits and
+// resets them: a uint64_t counter count, then one bit per counter (bit i of
+// byte i / 8), set if the counter is non-zero. A counter is non-zero in a
+// merged profile iff it is in one of the inputs' profiles, so OR-ing these
+// gives the coverage of any prefix of the queue without llvm-profdata.
+// Not instrumented itself, and calls nothing that is, so it adds no counts
+// of its own. Assumes the default 8-byte counters (no
+// -enable-single-byte-coverage).
+__attribute__((no_profile_instrument_function)) inline bool writeCounterBits(const char *dir, size_t index) {
+    const uint64_t *begin = reinterpret_cast<const uint64_t *>(__llvm_profile_begin_counters());
+    const uint64_t *end = reinterpret_cast<const uint64_t *>(__llvm_profile_end_counters());
+    const uint64_t count = end - begin;
+    char name[4096];
+    std::snprintf(name, sizeof(name), "%s/%06zu.bits", dir, index);
+    FILE *f = std::fopen(name, "wb");
+    bool ok = f && std::fwrite(&count, sizeof(count), 1, f) == 1;
+    uint8_t chunk[4096];
+    for (uint64_t k = 0; ok && k < count; k += 8 * sizeof(chunk)) {
+        const uint64_t n = count - k < 8 * sizeof(chunk) ? count - k : 8 * sizeof(chunk);
+        std::memset(chunk, 0, sizeof(chunk));
+        for (uint64_t j = 0; j < n; ++j) {
+            if (begin[k + j])
+                chunk[j / 8] |= static_cast<uint8_t>(1u << (j % 8));
+        }
+        ok = std::fwrite(chunk, 1, (n + 7) / 8, f) == (n + 7) / 8;
+    }
+    __llvm_profile_reset_counters();
+    return f && std::fclose(f) == 0 && ok;
+}
+
+// --replay [--profile-dir DIR] [--shard-size N] [--index-base K]
+//          [--counter-dir DIR] PATH...
+//
+// Runs every testcase in one process instead of one process per file. In a
+// coverage build with --profile-dir, the counters are written to one
+// .profraw per shard of N inputs (default: all of them) and reset. A crash
+// ends the process and loses the current shard and every input after it;
+// the caller resumes from the first shard without a profile, with
+// --index-base K giving the position of the first PATH in the whole list
+// (coverage.sh's replay_range, plot_coverage_fast.py's run_coverage_batch).
+// --counter-dir instead writes one .bits file per input, read straight from
+// the counters in memory (see writeCounterBits and plot_coverage_fast.py).
+inline int replayMain(int argc, char **argv) {
+    std::string profileDir;
+    std::string counterDir;
+    size_t shardSize = 0;
+    size_t indexBase = 0;
+    int i = 2;
+    for (; i + 1 < argc; i += 2) {
+        std::string opt = argv[i];
+        if (opt == "--profile-dir")
+            profileDir = argv[i + 1];
+        else if (opt == "--counter-dir")
+            counterDir = argv[i + 1];
+        else if (opt == "--shard-size")
+            shardSize = std::strtoull(argv[i + 1], nullptr, 10);
+        else if (opt == "--index-base")
+            indexBase = std::strtoull(argv[i + 1], nullptr, 10);
+        else
+            break;
+    }
+    std::vector<std::string> paths = collectInputs(argv + i, argv + argc);
+    if (paths.size() > 1)
+        readerCache().prebuild();
+
+    bool profiling = !profileDir.empty();
+    if (profiling && !__llvm_profile_write_file) {
+        std::fprintf(stderr, "[harness] not a -fprofile-instr-generate build; ignoring --profile-dir\n");
+        profiling = false;
+    }
+    bool counting = !counterDir.empty();
+    if (counting && !__llvm_profile_begin_counters) {
+        std::fprintf(stderr, "[harness] not a -fprofile-instr-generate build; ignoring --counter-dir\n");
+        counting = false;
+    }
+    if (profiling && counting) {
+        // Each .bits write resets the counters the .profraw shards add up
+        std::fprintf(stderr, "[harness] --profile-dir and --counter-dir cannot be combined\n");
+        return 1;
+    }
+    if (shardSize == 0)
+        shardSize = paths.size();
+
+    size_t shardStart = 0;
+    for (size_t n = 0; n < paths.size(); ++n) {
+        Input input;
+        if (input.open(paths[n].c_str()))
+            execute(input.data(), input.size());
+        else
+            std::fprintf(stderr, "[harness] cannot open %s: %s\n", paths[n].c_str(), std::strerror(errno));
+
+        if (counting && !writeCounterBits(counterDir.c_str(), indexBase + n)) {
+            std::fprintf(stderr, "[harness] cannot write to %s: %s\n", counterDir.c_str(), std::strerror(errno));
+            return 1;
+        }
+        bool last = n + 1 == paths.size();
+        if (profiling && (last || n + 1 - shardStart == shardSize)) {
+            std::fflush(stdout);
+            flushProfile(profileDir, indexBase + shardStart, last);
+            shardStart = n + 1;
+        }
+    }
+    return 0;
+}
+
+// A testcase as the parser sees it; kUnknown where the harness cannot tell.
+struct Shape {
+    static constexpr uint32_t kUnknown = UINT32_MAX;
+
+    uint32_t mask = kUnknown;
+    uint32_t documents = 0;
+    uint32_t nodes = kUnknown;      // encoder values, all documents
+    uint32_t maxDepth = kUnknown;   // deepest encoder value
+
+    // Adds one encoder input's JsonEncoder::extent()
+    template <class Extent>
+    void addEncoded(const Extent &extent) {
+        if (nodes == kUnknown)
+            nodes = maxDepth = 0;
+        nodes += static_cast<uint32_t>(extent.nodes);
+        maxDepth = std::max(maxDepth, static_cast<uint32_t>(extent.maxDepth));
+        ++documents;
+    }
+};
+
+// Input being timed, for the hang report.
+inline const char *profiledInput = nullptr;
+inline unsigned hangMs = 0;
+
+inline void reportHang(int) {
+    // Async-signal-safe: write(2) only
+    const char prefix[] = "[harness] hang: over the --hang-ms CPU budget in one exec of ";
+    ssize_t ignored = write(STDERR_FILENO, prefix, sizeof(prefix) - 1);
+    ignored = write(STDERR_FILENO, profiledInput, std::strlen(profiledInput));
+    ignored = write(STDERR_FILENO, "\n", 1);
+    (void)ignored;
+    _exit(124);  // timeout(1)'s status
+}
+
+inline uint64_t threadCpuNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000u + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+// --profile-replay K [--top N] [--hang-ms MS] [-o FILE] [--summary FILE] PATH...
+//
+// Runs every testcase once untimed, then K times timed by this thread's CPU
+// clock, so a busy host or a page fault in another thread does not count.
+// An input's cost is the median of its K runs. stderr gets the percentiles
+// of that cost over the corpus, the N slowest inputs (default 20) with their
+// shape (see testcaseShape), and, per reader option, how much more often it
+// is on among the slowest 1% than overall, with the mean cost with it on and
+// off: an option that only the slow tail shares (rejectDupKeys on wide
+// objects, collectComments on long inputs) is where to look. FILE gets
+// every input, slowest first. One exec using more than MS ms of CPU
+// (default 1000) ends the run with the input's name, as a hang would for
+// afl-fuzz. Build with -DHARNESS_ECHO=0, or the console writes are timed too.
+//
+// --summary FILE writes the totals as one JSON object for perf_gate.py:
+// CPU per pass, documents per second (null without testcaseShape),
+// operator new calls per timed exec (null unless harness_alloc.h is in the
+// build, e.g. with -DHARNESS_COUNT_ALLOCS) and the process peak RSS.
+inline int profileReplayMain(int argc, char **argv) {
+    if (argc < 4) {
+        std::fprintf(stderr, "usage: %s --profile-replay K [--top N] [--hang-ms MS] [-o FILE] "
+                             "[--summary FILE] PATH...\n", argv[0]);
+        return 1;
+    }
+    const size_t reps = std::max<size_t>(1, std::strtoull(argv[2], nullptr, 10));
+    size_t top = 20;
+    const char *outPath = nullptr;
+    const char *summaryPath = nullptr;
+    hangMs = 1000;
+    int i = 3;
+    for (; i + 1 < argc; i += 2) {
+        std::string opt = argv[i];
+        if (opt == "--top")
+            top = std::strtoull(argv[i + 1], nullptr, 10);
+        else if (opt == "--hang-ms")
+            hangMs = static_cast<unsigned>(std::strtoul(argv[i + 1], nullptr, 10));
+        else if (opt == "-o")
+            outPath = argv[i + 1];
+        else if (opt == "--summary")
+            summaryPath = argv[i + 1];
+        else
+            break;
+    }
+    std::vector<std::string> paths = collectInputs(argv + i, argv + argc);
+    if (paths.empty()) {
+        std::fprintf(stderr, "[harness] --profile-replay: no inputs\n");
+        return 1;
+    }
+    readerCache().prebuild();
+
+    if (kEcho) {
+        std::fprintf(stderr, "[harness] echo build: console writes are timed too; "
+                             "rebuild with -DHARNESS_ECHO=0 for parser-only times\n");
+        std::fflush(stdout);
+        int null = open("/dev/null", O_WRONLY);
+        if (null >= 0) {
+            dup2(null, STDOUT_FILENO);
+            close(null);
+        }
+    }
+    if (hangMs)
+        std::signal(SIGPROF, reportHang);
+
+    struct Entry {
+        size_t path;
+        size_t bytes;
+        uint64_t medianNs;
+        uint64_t minNs;
+        Shape shape;
+    };
+    std::vector<Entry> entries;
+    std::vector<uint64_t> runs(reps);
+    uint64_t totalNs = 0;
+    uint64_t documents = 0;
+#ifdef HARNESS_HAVE_ALLOC_COUNTERS
+    uint64_t timedAllocs = 0;       // operator new calls in timed runs
+#endif
+    for (size_t n = 0; n < paths.size(); ++n) {
+        Input input;
+        if (!input.open(paths[n].c_str())) {
+            std::fprintf(stderr, "[harness] cannot open %s: %s\n", paths[n].c_str(), std::strerror(errno));
+            continue;
+        }
+        profiledInput = paths[n].c_str();
+        for (size_t r = 0; r <= reps; ++r) {
+            // The ITIMER_PROF budget restarts for every exec
+            struct itimerval budget = {{0, 0}, {static_cast<time_t>(hangMs / 1000),
+                                                static_cast<suseconds_t>(hangMs % 1000 * 1000)}};
+            if (hangMs)
+                setitimer(ITIMER_PROF, &budget, nullptr);
+#ifdef HARNESS_HAVE_ALLOC_COUNTERS
+            const uint64_t allocsBefore = alloc::counters.calls + alloc::counters.arenaCalls;
+#endif
+            uint64_t start = threadCpuNs();
+            execute(input.data(), input.size());
+            uint64_t ns = threadCpuNs() - start;
+            if (r > 0) {  // run 0 warms caches and first-use allocations
+                runs[r - 1] = ns;
+#ifdef HARNESS_HAVE_ALLOC_COUNTERS
+                timedAllocs += alloc::counters.calls + alloc::counters.arenaCalls - allocsBefore;
+#endif
+            }
+        }
+        if (hangMs) {
+            struct itimerval off = {};
+            setitimer(ITIMER_PROF, &off, nullptr);
+        }
+
+        std::sort(runs.begin(), runs.end());
+        Entry e{n, input.size(), runs[reps / 2], runs[0], Shape{}};
+#ifdef HARNESS_SHAPE
+        e.shape = testcaseShape(input.data(), input.size());
+#endif
+        totalNs += e.medianNs;
+        documents += e.shape.documents;
+        entries.push_back(e);
+    }
+    profiledInput = nullptr;
+    if (entries.empty())
+        return 1;
+
+    std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+        return a.medianNs != b.medianNs ? a.medianNs > b.medianNs : a.path < b.path;
+    });
+    // Slowest first: percentile q is at index (1 - q) * (n - 1)
+    auto percentileUs = [&](double q) {
+        return entries[static_cast<size_t>((1 - q) * (entries.size() - 1) + 0.5)].medianNs / 1e3;
+    };
+    std::fprintf(stderr,
+                 "[harness] profile-replay: %zu inputs x %zu runs, %.1f ms CPU per pass; per exec "
+                 "p50 %.1f us, p90 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us\n",
+                 entries.size(), reps, totalNs / 1e6, percentileUs(0.5), percentileUs(0.9),
+                 percentileUs(0.99), percentileUs(0.999), entries[0].medianNs / 1e3);
+
+    auto field = [](char *buf, size_t size, uint32_t value, bool hex) {
+        if (value == Shape::kUnknown)
+            std::snprintf(buf, size, "-");
+        else
+            std::snprintf(buf, size, hex ? "0x%03x" : "%u", value);
+        return buf;
+    };
+    char mask[16], nodes[16], depth[16];
+    std::fprintf(stderr, "[harness] %8s %8s %8s %6s %5s %7s %5s  input\n",
+                 "us", "us/KB", "bytes", "mask", "docs", "nodes", "depth");
+    for (size_t k = 0; k < std::min(top, entries.size()); ++k) {
+        const Entry &e = entries[k];
+        std::fprintf(stderr, "[harness] %8.1f %8.1f %8zu %6s %5u %7s %5s  %s\n",
+                     e.medianNs / 1e3, e.bytes ? e.medianNs / 1e3 / (e.bytes / 1024.0) : 0.0, e.bytes,
+                     field(mask, sizeof(mask), e.shape.mask, true), e.shape.documents,
+                     field(nodes, sizeof(nodes), e.shape.nodes, false),
+                     field(depth, sizeof(depth), e.shape.maxDepth, false), paths[e.path].c_str());
+    }
+
+    // Option attribution over the inputs whose mask is known
+    std::vector<const Entry *> masked;
+    for (const Entry &e : entries) {
+        if (e.shape.mask != Shape::kUnknown)
+            masked.push_back(&e);
+    }
+    if (!masked.empty()) {
+        const size_t tail = std::max<size_t>(1, masked.size() / 100);
+        std::fprintf(stderr, "[harness] options: share of the slowest %zu inputs vs all %zu, "
+                             "mean us with the option on / off\n", tail, masked.size());
+        for (unsigned bit = 0; bit < kNumOptionBits; ++bit) {
+            size_t inTail = 0, on = 0;
+            double onNs = 0, offNs = 0;
+            for (size_t k = 0; k < masked.size(); ++k) {
+                bool set = (masked[k]->shape.mask >> bit & 1) != 0;
+                inTail += set && k < tail;
+                on += set;
+                (set ? onNs : offNs) += masked[k]->medianNs;
+            }
+            size_t off = masked.size() - on;
+            std::fprintf(stderr, "[harness]   %-28s %5.1f%% vs %5.1f%%  %8.1f / %8.1f\n", kOptionNames[bit],
+                         100.0 * inTail / tail, 100.0 * on / masked.size(),
+                         on ? onNs / on / 1e3 : 0.0, off ? offNs / off / 1e3 : 0.0);
+        }
+    }
+
+    if (outPath) {
+        FILE *out = std::fopen(outPath, "w");
+        if (!out) {
+            std::fprintf(stderr, "[harness] cannot write %s: %s\n", outPath, std::strerror(errno));
+            return 1;
+        }
+        std::fprintf(out, "median_ns\tmin_ns\tbytes\tmask\tdocuments\tnodes\tmax_depth\tinput\n");
+        for (const Entry &e : entries) {
+            std::fprintf(out, "%llu\t%llu\t%zu\t%s\t%u\t%s\t%s\t%s\n",
+                         static_cast<unsigned long long>(e.medianNs), static_cast<unsigned long long>(e.minNs),
+                         e.bytes, field(mask, sizeof(mask), e.shape.mask, true), e.shape.documents,
+                         field(nodes, sizeof(nodes), e.shape.nodes, false),
+                         field(depth, sizeof(depth), e.shape.maxDepth, false), paths[e.path].c_str());
+        }
+        std::fclose(out);
+    }
+
+    if (summaryPath) {
+        FILE *out = std::fopen(summaryPath, "w");
+        if (!out) {
+            std::fprintf(stderr, "[harness] cannot write %s: %s\n", summaryPath, std::strerror(errno));
+            return 1;
+        }
+        const double seconds = totalNs / 1e9;
+        // VmHWM rather than ru_maxrss, which keeps the spawning process's own
+        // peak across exec (a 20 MB python parent would mask every harness)
+        long peakRssKb = -1;
+        if (FILE *status = std::fopen("/proc/self/status", "r")) {
+            char line[128];
+            while (std::fgets(line, sizeof(line), status)) {
+                if (std::sscanf(line, "VmHWM: %ld kB", &peakRssKb) == 1)
+                    break;
+            }
+            std::fclose(status);
+        }
+        if (peakRssKb < 0) {
+            struct rusage usage;
+            getrusage(RUSAGE_SELF, &usage);
+            peakRssKb = usage.ru_maxrss;
+        }
+        char docsPerSec[32] = "null", allocsPerExec[32] = "null";
+#ifdef HARNESS_SHAPE
+        if (seconds > 0)
+            std::snprintf(docsPerSec, sizeof(docsPerSec), "%.1f", documents / seconds);
+#endif
+#ifdef HARNESS_HAVE_ALLOC_COUNTERS
+        std::snprintf(allocsPerExec, sizeof(allocsPerExec), "%.3f",
+                      static_cast<double>(timedAllocs) / (entries.size() * reps));
+#endif
+        std::fprintf(out,
+                     "{\"inputs\": %zu, \"runs\": %zu, \"cpu_ns_per_pass\": %llu, \"documents\": %llu, "
+                     "\"execs_per_sec\": %.1f, \"docs_per_sec\": %s, \"allocs_per_exec\": %s, "
+                     "\"peak_rss_kb\": %ld}\n",
+                     entries.size(), reps, static_cast<unsigned long long>(totalNs),
+                     static_cast<unsigned long long>(documents), seconds > 0 ? entries.size() / seconds : 0.0,
+                     docsPerSec, allocsPerExec, peakRssKb);
+        std::fclose(out);
+    }
+    return 0;
+}
+
+// --minimize OUT_DIR PATH...
+//
+// afl-cmin without a fork per input: every input runs once in this process
+// with the coverage map (harness_cov.h) reset before it. Its features are
+// the (edge, hit bucket) pairs it reached, its cost the exec time. A greedy
+// weighted set cover then keeps, until every feature is covered, the input
+// with the lowest cost per newly covered feature. Byte-identical inputs run
+// only once. Kept inputs are copied to OUT_DIR under their own names.
+inline int minimizeMain(int argc, char **argv) {
+    if (argc < 4) {
+        std::fprintf(stderr, "usage: %s --minimize OUT_DIR PATH...\n", argv[0]);
+        return 1;
+    }
+    if (!coverageAvailable()) {
+        std::fprintf(stderr, "[harness] --minimize needs an afl-clang-fast or -DHARNESS_SANCOV build\n");
+        return 1;
+    }
+    const std::string outDir = argv[2];
+    std::vector<std::string> paths = collectInputs(argv + 3, argv + argc);
+    readerCache().prebuild();
+
+    struct Candidate {
+        size_t path;
+        size_t size;
+        uint64_t costNs;
+        std::vector<uint32_t> features;
+    };
+    std::vector<Candidate> candidates;
+    std::unordered_set<std::string> seen;
+    uint32_t numFeatures = 0;
+    size_t duplicates = 0;
+
+    for (size_t n = 0; n < paths.size(); ++n) {
+        Input input;
+        if (!input.open(paths[n].c_str())) {
+            std::fprintf(stderr, "[harness] cannot open %s: %s\n", paths[n].c_str(), std::strerror(errno));
+            continue;
+        }
+        if (!seen.emplace(reinterpret_cast<const char *>(input.data()), input.size()).second) {
+            ++duplicates;
+            continue;
+        }
+        resetCoverage();
+        auto start = std::chrono::steady_clock::now();
+        execute(input.data(), input.size());
+        uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::steady_clock::now() - start).count();
+
+        Candidate c{n, input.size(), ns + 1, {}};
+        forEachEdge([&](uint32_t edge, uint8_t count) {
+            c.features.push_back(edge * 8 + hitBucket(count));
+        });
+        if (!c.features.empty())
+            numFeatures = std::max(numFeatures, c.features.back() + 1);
+        candidates.push_back(std::move(c));
+    }
+    std::fflush(stdout);
+
+    // Lazy greedy: a candidate's gain only shrinks as others are kept, so a
+    // popped entry whose refreshed ratio still beats the next one is the
+    // true minimum.
+    std::vector<bool> covered(numFeatures);
+    auto gain = [&](const Candidate &c) {
+        size_t g = 0;
+        for (uint32_t f : c.features)
+            g += !covered[f];
+        return g;
+    };
+    struct Entry {
+        double costPerFeature;
+        size_t size;
+        size_t index;
+        bool operator<(const Entry &o) const {  // max-heap on "worse"
+            return costPerFeature != o.costPerFeature ? costPerFeature > o.costPerFeature : size > o.size;
+        }
+    };
+    std::priority_queue<Entry> heap;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        if (size_t g = gain(candidates[i]))
+            heap.push({static_cast<double>(candidates[i].costNs) / g, candidates[i].size, i});
+    }
+
+    std::vector<size_t> kept;
+    size_t coveredCount = 0;
+    while (!heap.empty()) {
+        Entry top = heap.top();
+        heap.pop();
+        const Candidate &c = candidates[top.index];
+        size_t g = gain(c);
+        if (g == 0)
+            continue;
+        Entry refreshed{static_cast<double>(c.costNs) / g, c.size, top.index};
+        if (!heap.empty() && refreshed < heap.top()) {
+            heap.push(refreshed);
+            continue;
+        }
+        for (uint32_t f : c.features)
+            covered[f] = true;
+        coveredCount += g;
+        kept.push_back(top.index);
+    }
+
+    if (mkdir(outDir.c_str(), 0755) != 0 && errno != EEXIST) {
+        std::fprintf(stderr, "[harness] cannot create %s: %s\n", outDir.c_str(), std::strerror(errno));
+        return 1;
+    }
+    uint64_t keptNs = 0;
+    for (size_t i : kept) {
+        const std::string &src = paths[candidates[i].path];
+        std::string dst = outDir + "/" + inputName(src);
+        Input input;
+        FILE *f = input.open(src.c_str()) ? std::fopen(dst.c_str(), "wb") : nullptr;
+        if (!f || std::fwrite(input.data(), 1, input.size(), f) != input.size()) {
+            std::fprintf(stderr, "[harness] cannot write %s: %s\n", dst.c_str(), std::strerror(errno));
+            if (f)
+                std::fclose(f);
+            return 1;
+        }
+        std::fclose(f);
+        keptNs += candidates[i].costNs;
+    }
+
+    std::fprintf(stderr,
+                 "[harness] minimize: %zu inputs (%zu duplicates), %zu features, "
+                 "kept %zu inputs (%.3f ms per pass) in %s\n",
+                 paths.size(), duplicates, coveredCount, kept.size(), keptNs / 1e6, outDir.c_str());
+    return 0;
+}
+
+// The threads a -j N option can have: 1 with harness_alloc.h in the build
+// (-DHARNESS_COUNT_ALLOCS, -DHARNESS_VALUE_ARENA), whose operator
+// new/delete counters and arena are single-threaded.
+inline unsigned usableJobs(unsigned jobs) {
+    if (jobs == 0)
+        return 1;
+#ifdef HARNESS_HAVE_ALLOC_COUNTERS
+    static bool warned = false;
+    if (jobs > 1 && !warned) {
+        std::fprintf(stderr, "[harness] harness_alloc.h is single-threaded; running on one thread, not %u\n", jobs);
+        warned = true;
+    }
+    return 1;
+#else
+    return jobs;
+#endif
+}
+
+// Runs fn(i) for every i in [0, n) on `jobs` threads. Each thread starts on
+// an equal slice and takes indices from its front. A thread that runs dry
+// steals the back half of the largest slice left, so a few huge inputs
+// cannot leave cores idle while one thread works through them.
+template <class Fn>
+inline void parallelFor(size_t n, unsigned jobs, Fn fn) {
+    jobs = usableJobs(jobs);
+    if (jobs > n)
+        jobs = n ? static_cast<unsigned>(n) : 1;
+
+    // [begin, end) of one slice, packed so a whole slice moves with one CAS
+    struct alignas(64) Slice {
+        std::atomic<uint64_t> range;
+    };
+    auto pack = [](uint64_t begin, uint64_t end) { return begin << 32 | end; };
+    std::unique_ptr<Slice[]> slices(new Slice[jobs]);
+    for (unsigned t = 0; t < jobs; ++t)
+        slices[t].range = pack(n * t / jobs, n * (t + 1) / jobs);
+
+    auto work = [&](unsigned self) {
+        std::atomic<uint64_t> &own = slices[self].range;
+        for (;;) {
+            uint64_t r = own.load(std::memory_order_acquire);
+            while ((r >> 32) < (r & 0xffffffff)) {
+                if (own.compare_exchange_weak(r, r + (uint64_t{1} << 32), std::memory_order_acq_rel)) {
+                    fn(static_cast<size_t>(r >> 32));
+                    r = own.load(std::memory_order_acquire);
+                }
+            }
+
+            unsigned victim = self;
+            uint64_t most = 0;
+            for (unsigned t = 0; t < jobs; ++t) {
+                uint64_t v = slices[t].range.load(std::memory_order_relaxed);
+                uint64_t begin = v >> 32, end = v & 0xffffffff;
+                if (end > begin && end - begin > most) {
+                    most = end - begin;
+                    victim = t;
+                }
+            }
+            if (most == 0)
+                return;  // nothing left anywhere; slices only ever shrink
+            uint64_t v = slices[victim].range.load(std::memory_order_acquire);
+            uint64_t begin = v >> 32, end = v & 0xffffffff;
+            if (begin >= end)
+                continue;
+            uint64_t mid = begin + (end - begin) / 2;
+            if (slices[victim].range.compare_exchange_strong(v, pack(begin, mid), std::memory_order_acq_rel))
+                own.store(pack(mid, end), std::memory_order_release);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < jobs; ++t)
+        workers.emplace_back(work, t);
+    work(0);
+    for (std::thread &w : workers)
+        w.join();
+}
+
+// What one testcase did in --batch: how many documents it held, how many
+// failed to parse, and an FNV-1a hash over every document's verdict and
+// error text, so a changed message shows up as a changed hash.
+struct Outcome {
+    enum Verdict { Ok, Err, Threw, Unreadable };
+
+    Verdict verdict = Ok;
+    uint32_t documents = 0;
+    uint32_t failed = 0;
+    uint64_t hash = 14695981039346656037ULL;
+
+    void document(bool ok, const std::string &errs) {
+        ++documents;
+        if (!ok) {
+            ++failed;
+            if (verdict == Ok)
+                verdict = Err;
+        }
+        mix(ok ? "\x01" : "\x00", 1);
+        mix(errs.data(), errs.size());
+        mix("\xff", 1);
+    }
+
+    // Something other than Json::Exception escaped the parse
+    void threw(const char *what) {
+        verdict = Threw;
+        mix(what, std::strlen(what));
+    }
+
+    const char *verdictName() const {
+        static const char *const kNames[] = {"ok", "err", "threw", "unreadable"};
+        return kNames[verdict];
+    }
+
+    void mix(const char *p, size_t n) {
+        for (size_t i = 0; i < n; ++i)
+            hash = (hash ^ static_cast<uint8_t>(p[i])) * 1099511628211ULL;
+    }
+};
+
+#ifdef HARNESS_BATCH
+
+// Input each --batch worker is on, for the crash report.
+inline thread_local const char *batchInput = nullptr;
+
+inline void reportBatchCrash(int sig) {
+    // Async-signal-safe: write(2) only, then die of the same signal
+    const char *path = batchInput ? batchInput : "(between inputs)";
+    const char prefix[] = "[harness] batch crashed on ";
+    ssize_t ignored = write(STDERR_FILENO, prefix, sizeof(prefix) - 1);
+    ignored = write(STDERR_FILENO, path, std::strlen(path));
+    ignored = write(STDERR_FILENO, "\n", 1);
+    (void)ignored;
+    std::signal(sig, SIG_DFL);
+    std::raise(sig);
+}
+
+// `harness --batch [-j N] [-o FILE] PATH...`: parses every input on N
+// threads (default: one per core), each with its own ReaderCache, and
+// writes one row per input, in path order, to FILE (default stdout):
+//     input  verdict  documents  failed  error_hash
+// Rows depend only on the input and the jsoncpp build, never on N, so the
+// files from two builds diff to exactly the inputs whose verdict or error
+// text changed. A crash names its input and kills the run.
+inline int batchMain(int argc, char **argv) {
+    unsigned jobs = std::thread::hardware_concurrency();
+    const char *outPath = nullptr;
+    int i = 2;
+    for (; i + 1 < argc; i += 2) {
+        std::string opt = argv[i];
+        if (opt == "-j")
+            jobs = static_cast<unsigned>(std::strtoul(argv[i + 1], nullptr, 10));
+        else if (opt == "-o")
+            outPath = argv[i + 1];
+        else
+            break;
+    }
+    std::vector<std::string> paths = collectInputs(argv + i, argv + argc);
+    if (paths.empty()) {
+        std::fprintf(stderr, "usage: %s --batch [-j N] [-o FILE] PATH...\n", argv[0]);
+        return 1;
+    }
+    jobs = usableJobs(jobs);
+
+    for (int sig : {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT})
+        std::signal(sig, reportBatchCrash);
+
+    std::vector<Outcome> outcomes(paths.size());
+    auto start = std::chrono::steady_clock::now();
+    parallelFor(paths.size(), jobs, [&](size_t k) {
+        thread_local ReaderCache readers;
+        batchInput = paths[k].c_str();
+        Input input;
+        if (input.open(paths[k].c_str()))
+            outcomes[k] = evaluateTestcase(input.data(), input.size(), readers);
+        else
+            outcomes[k].verdict = Outcome::Unreadable;
+        batchInput = nullptr;
+    });
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    FILE *out = outPath ? std::fopen(outPath, "w") : stdout;
+    if (!out) {
+        std::fprintf(stderr, "[harness] cannot write %s: %s\n", outPath, std::strerror(errno));
+        return 1;
+    }
+    std::fprintf(out, "# jsoncpp %s\ninput\tverdict\tdocuments\tfailed\terror_hash\n", JSONCPP_VERSION_STRING);
+    size_t counts[4] = {};
+    for (size_t k = 0; k < paths.size(); ++k) {
+        const Outcome &o = outcomes[k];
+        ++counts[o.verdict];
+        std::fprintf(out, "%s\t%s\t%u\t%u\t%016llx\n", paths[k].c_str(), o.verdictName(), o.documents, o.failed,
+                     static_cast<unsigned long long>(o.hash));
+    }
+    if (outPath)
+        std::fclose(out);
+    else
+        std::fflush(out);
+
+    std::fprintf(stderr, "[harness] batch: %zu inputs on %u threads in %.2f s "
+                         "(%zu ok, %zu err, %zu threw, %zu unreadable)\n",
+                 paths.size(), jobs, seconds, counts[Outcome::Ok], counts[Outcome::Err],
+                 counts[Outcome::Threw], counts[Outcome::Unreadable]);
+    return counts[Outcome::Unreadable] ? 1 : 0;
+}
+
+#endif
+
+inline int runMain(int argc, char **argv) {
+    if (kEcho) {
+        static char stdoutBuf[1 << 16];
+        std::setvbuf(stdout, stdoutBuf, _IOFBF, sizeof(stdoutBuf));
+    }
+
+    profileInit();
+    coverageSnapshot().open();
+
+    if (argc > 1 && std::strcmp(argv[1], "--replay") == 0)
+        return replayMain(argc, argv);
+    if (argc > 1 && std::strcmp(argv[1], "--minimize") == 0)
+        return minimizeMain(argc, argv);
+    if (argc > 1 && std::strcmp(argv[1], "--profile-replay") == 0)
+        return profileReplayMain(argc, argv);
+#ifdef HARNESS_TMIN
+    if (argc > 1 && std::strcmp(argv[1], "--tmin") == 0)
+        return tminMain(argc, argv);
+#endif
+#ifdef HARNESS_BATCH
+    if (argc > 1 && std::strcmp(argv[1], "--batch") == 0)
+        return batchMain(argc, argv);
+#endif
+
+    if (argc > 1) {
+        Input input;
+        if (!input.open(argv[1])) {
+            std::fprintf(stderr, "[harness] cannot open %s: %s\n", argv[1], std::strerror(errno));
+            return 1;
+        }
+        execute(input.data(), input.size());
+        return 0;
+    }
+
+#ifdef HARNESS_AFL_PERSISTENT
+    // Before the fork point, so every forked child starts with all readers
+    readerCache().prebuild();
+#ifdef __AFL_HAVE_MANUAL_CONTROL
+    __AFL_INIT();
+#endif
+    // Must be fetched after __AFL_INIT and before __AFL_LOOP.
+    const uint8_t *buf = __AFL_FUZZ_TESTCASE_BUF;
+    while (__AFL_LOOP(AFL_LOOP_COUNT)) {
+        size_t len = __AFL_FUZZ_TESTCASE_LEN;
+        execute(buf, len);
+    }
+#else
+    // Plain build (or replay): the whole of stdin is one testcase.
+    Input input;
+    {
+        StageTimer timer(Stage::Load);
+        input.load(STDIN_FILENO);
+        timer.bytesOut(input.size());
+    }
+    execute(input.data(), input.size());
+#endif
+    return 0;
+}
+
+} // namespace harness
+
+extern "C" int LLVMFuzzerInitialize(int *argc, char ***argv) {
+    (void)argc;
+    (void)argv;
+    harness::profileInit();
+    harness::coverageSnapshot().open();
+    harness::readerCache().prebuild();
+    return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    harness::execute(data, size);
+    return 0;
+}
+
+#if !defined(HARNESS_LIBFUZZER) && !defined(HARNESS_NO_MAIN)
+int main(int argc, char **argv) {
+    return harness::runMain(argc, argv);
+}
+#endif
@@ -0,0 +1,247 @@
+// Heap accounting for the harnesses: replaces the global operator new and
+// delete with malloc/free wrappers that count calls, requested bytes and
+// live bytes (by malloc_usable_size, so frees need no size). Include from
+// exactly one translation unit; the replacement is program-wide.
+//
+// -DHARNESS_VALUE_ARENA adds a value arena: while an ArenaScope is open,
+// requests up to arena::kMaxSize are bumped out of 64 KB chunks of one
+// reserved region (HARNESS_VALUE_ARENA_MB, default 256) instead of going to
+// malloc. A delete only decrements its chunk's live count; a chunk whose
+// count reaches zero is reused whole, so a parsed tree freed at once costs
+// no free() calls, and anything that outlives the scope (a reader's
+// internal stacks, say) just keeps its chunk. The price is memory: one
+// survivor pins 64 KB, so the heap peak runs above malloc's. Single-threaded
+// builds only.
+//
+// harness.h includes this itself under -DHARNESS_COUNT_ALLOCS, so that
+// --profile-replay --summary can report operator new calls per exec.
+#pragma once
+
+#define HARNESS_HAVE_ALLOC_COUNTERS 1
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <malloc.h>
+#include <sys/resource.h>
+#ifdef HARNESS_VALUE_ARENA
+#include <sys/mman.h>
+#endif
+
+namespace harness {
+namespace alloc {
+
+struct Counters {
+    uint64_t calls = 0;       // operator new calls served by malloc
+    uint64_t arenaCalls = 0;  // operator new calls served by the value arena
+    uint64_t bytes = 0;       // bytes requested
+    uint64_t live = 0;        // bytes currently allocated
+    uint64_t peakLive = 0;
+};
+
+inline Counters counters;
+
+#ifdef HARNESS_VALUE_ARENA
+
+#ifndef HARNESS_VALUE_ARENA_MB
+#define HARNESS_VALUE_ARENA_MB 256
+#endif
+
+namespace arena {
+
+constexpr size_t kChunkSize = size_t{64} << 10;
+constexpr size_t kMaxSize = kChunkSize / 8;   // larger requests go to malloc
+constexpr size_t kNumChunks = (size_t{HARNESS_VALUE_ARENA_MB} << 20) / kChunkSize;
+constexpr size_t kAlign = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+constexpr uint32_t kNoChunk = UINT32_MAX;
+
+inline char *base = nullptr;
+inline bool unavailable = false;      // the region could not be mapped
+inline unsigned scopes = 0;           // open ArenaScopes
+inline uint32_t current = kNoChunk;   // chunk being bumped
+inline size_t offset = 0;             // next free byte in it
+inline const char *last = nullptr;    // newest allocation in it, and its size
+inline size_t lastSize = 0;
+inline uint32_t untouched = 0;        // chunks from here on were never used
+inline uint32_t live[kNumChunks];     // allocations not yet deleted, per chunk
+inline uint32_t used[kNumChunks];     // bytes handed out, per chunk
+inline uint32_t freeChunks[kNumChunks];
+inline uint32_t numFree = 0;
+
+inline bool owns(const void *p) {
+    const char *c = static_cast<const char *>(p);
+    return base && c >= base && c < base + kNumChunks * kChunkSize;
+}
+
+inline bool nextChunk() {
+    // The old chunk still has live allocations (an empty current chunk is
+    // rewound, never left); release() frees it when the last one goes.
+    if (numFree)
+        current = freeChunks[--numFree];
+    else if (untouched < kNumChunks)
+        current = untouched++;
+    else
+        current = kNoChunk;
+    offset = 0;
+    last = nullptr;
+    return current != kNoChunk;
+}
+
+// Memory for `size` bytes (rounded up in place), or nullptr to use malloc.
+inline void *allocate(size_t &size) {
+    if (!scopes || size > kMaxSize || unavailable)
+        return nullptr;
+    if (!base) {
+        void *region = mmap(nullptr, kNumChunks * kChunkSize, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (region == MAP_FAILED) {
+            unavailable = true;
+            return nullptr;
+        }
+        base = static_cast<char *>(region);
+    }
+    size = size ? (size + kAlign - 1) & ~(kAlign - 1) : kAlign;
+    if ((current == kNoChunk || offset + size > kChunkSize) && !nextChunk())
+        return nullptr;
+    char *p = base + current * kChunkSize + offset;
+    last = p;
+    lastSize = size;
+    offset += size;
+    used[current] += static_cast<uint32_t>(size);
+    ++live[current];
+    return p;
+}
+
+// Deletes p; returns the bytes that became reusable: its own if it was the
+// newest allocation (short-lived temporaries, rewound over at once), the
+// rest of its chunk if it was the chunk's last live one.
+inline size_t release(const void *p) {
+    uint32_t c = static_cast<uint32_t>((static_cast<const char *>(p) - base) / kChunkSize);
+    size_t bytes = 0;
+    if (p == last) {
+        offset -= lastSize;
+        used[c] -= static_cast<uint32_t>(lastSize);
+        bytes = lastSize;
+        last = nullptr;
+    }
+    if (--live[c])
+        return bytes;
+    bytes += used[c];
+    used[c] = 0;
+    if (c == current) {
+        offset = 0;
+        last = nullptr;
+    } else {
+        freeChunks[numFree++] = c;
+    }
+    return bytes;
+}
+
+} // namespace arena
+
+// Serves operator new from the value arena while alive; scopes nest.
+class ArenaScope {
+public:
+    ArenaScope() {
+        ++arena::scopes;
+    }
+    ~ArenaScope() {
+        --arena::scopes;
+    }
+    ArenaScope(const ArenaScope &) = delete;
+    ArenaScope &operator=(const ArenaScope &) = delete;
+};
+
+#endif
+
+inline void *allocate(size_t size) {
+#ifdef HARNESS_VALUE_ARENA
+    size_t taken = size;
+    if (void *p = arena::allocate(taken)) {
+        ++counters.arenaCalls;
+        counters.bytes += size;
+        counters.live += taken;
+        if (counters.live > counters.peakLive)
+            counters.peakLive = counters.live;
+        return p;
+    }
+#endif
+    void *p = std::malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    ++counters.calls;
+    counters.bytes += size;
+    counters.live += malloc_usable_size(p);
+    if (counters.live > counters.peakLive)
+        counters.peakLive = counters.live;
+    return p;
+}
+
+inline void release(void *p) {
+    if (!p)
+        return;
+#ifdef HARNESS_VALUE_ARENA
+    if (arena::owns(p)) {
+        counters.live -= arena::release(p);
+        return;
+    }
+#endif
+    counters.live -= malloc_usable_size(p);
+    std::free(p);
+}
+
+// Starts a new peak measurement from the current live size.
+inline void resetPeak() {
+    counters.peakLive = counters.live;
+}
+
+// Process-wide peak resident set size so far, in MB.
+inline double peakRssMb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0;  // ru_maxrss is in KB on Linux
+}
+
+} // namespace alloc
+} // namespace harness
+
+void *operator new(size_t size) {
+    return harness::alloc::allocate(size);
+}
+
+void *operator new[](size_t size) {
+    return harness::alloc::allocate(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    try {
+        return harness::alloc::allocate(size);
+    } catch (const std::bad_alloc &) {
+        return nullptr;
+    }
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+    try {
+        return harness::alloc::allocate(size);
+    } catch (const std::bad_alloc &) {
+        return nullptr;
+    }
+}
+
+void operator delete(void *p) noexcept {
+    harness::alloc::release(p);
+}
+
+void operator delete[](void *p) noexcept {
+    harness::alloc::release(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    harness::alloc::release(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+    harness::alloc::release(p);
+}
@@ -0,0 +1,217 @@
+// In-process edge coverage for the harness driver (--minimize).
+//
+// Two sources, picked at build time:
+//   - afl-clang-fast / afl-clang-lto builds: AFL++'s own map, __afl_area_ptr.
+//     Outside afl-fuzz the AFL++ runtime points it at a private map, which is
+//     all an in-process reader needs.
+//   - -DHARNESS_SANCOV with SanitizerCoverage instead of AFL++:
+//       clang: -fsanitize-coverage=inline-8bit-counters (or trace-pc-guard)
+//       gcc:   -fsanitize-coverage=trace-pc (PCs hashed into a 64K map)
+//     This header then supplies the sancov callbacks, so it must not be
+//     combined with AFL++ instrumentation, whose runtime defines them too.
+//
+// Only code compiled with the flags is seen; link an instrumented jsoncpp
+// (like jsoncpp/build-afl) to measure the parser rather than the harness.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+// Keeps SanitizerCoverage out of the map readers below, which would
+// otherwise call back into the runtime once per word they scan.
+#ifdef HARNESS_SANCOV
+#if defined(__clang__)
+#define HARNESS_NO_COVERAGE __attribute__((no_sanitize("coverage")))
+#else
+#define HARNESS_NO_COVERAGE __attribute__((no_sanitize_coverage))
+#endif
+#else
+#define HARNESS_NO_COVERAGE
+#endif
+
+namespace harness {
+
+// AFL++ hit-count classes (1, 2, 3, 4-7, 8-15, 16-31, 32-127, 128+), so an
+// edge taken a different number of times counts as a different feature,
+// as in afl-cmin.
+inline unsigned hitBucket(uint8_t count) {
+    if (count < 4)
+        return count - 1;
+    if (count < 8)
+        return 3;
+    if (count < 16)
+        return 4;
+    if (count < 32)
+        return 5;
+    if (count < 128)
+        return 6;
+    return 7;
+}
+
+// Calls fn(base + i, counters[i]) for every non-zero counter, skipping 32
+// zero counters per test: most of a coverage map is zero.
+template <class Fn>
+HARNESS_NO_COVERAGE inline void forEachNonZero(const uint8_t *begin, const uint8_t *end, uint32_t base, Fn fn) {
+    const uint8_t *c = begin;
+    for (; end - c >= 32; c += 32) {
+        uint64_t words[4];
+        std::memcpy(words, c, sizeof(words));
+        if (!(words[0] | words[1] | words[2] | words[3]))
+            continue;
+        for (unsigned i = 0; i < 32; ++i) {
+            if (c[i])
+                fn(base + static_cast<uint32_t>(c - begin + i), c[i]);
+        }
+    }
+    for (; c != end; ++c) {
+        if (*c)
+            fn(base + static_cast<uint32_t>(c - begin), *c);
+    }
+}
+
+} // namespace harness
+
+#ifdef HARNESS_SANCOV
+
+namespace harness {
+namespace sancov {
+
+constexpr size_t kMaxRegions = 64;
+constexpr size_t kPcMapSize = 1 << 16;
+
+// inline-8bit-counters: one region per instrumented module
+struct Region {
+    uint8_t *begin;
+    uint8_t *end;
+};
+inline Region regions[kMaxRegions];
+inline size_t numRegions = 0;
+
+// trace-pc-guard and trace-pc share this map
+inline uint8_t pcMap[kPcMapSize];
+inline uint32_t numGuards = 0;
+
+} // namespace sancov
+} // namespace harness
+
+extern "C" {
+
+HARNESS_NO_COVERAGE
+void __sanitizer_cov_8bit_counters_init(uint8_t *begin, uint8_t *end) {
+    using namespace harness::sancov;
+    if (begin != end && numRegions < kMaxRegions)
+        regions[numRegions++] = {begin, end};
+}
+
+HARNESS_NO_COVERAGE
+void __sanitizer_cov_trace_pc_guard_init(uint32_t *begin, uint32_t *end) {
+    using namespace harness::sancov;
+    if (begin == end || *begin)
+        return;
+    for (uint32_t *guard = begin; guard != end; ++guard)
+        *guard = static_cast<uint32_t>(++numGuards % kPcMapSize);
+}
+
+HARNESS_NO_COVERAGE
+void __sanitizer_cov_trace_pc_guard(uint32_t *guard) {
+    ++harness::sancov::pcMap[*guard];
+}
+
+// Start of the executable's mapping (GNU ld, gold and lld define it).
+// trace-pc PCs are hashed relative to it, so an edge lands in the same map
+// slot in every process despite ASLR (HARNESS_COV_SNAPSHOT shares the map).
+extern char __executable_start __attribute__((weak));
+
+HARNESS_NO_COVERAGE
+void __sanitizer_cov_trace_pc(void) {
+    uintptr_t pc = reinterpret_cast<uintptr_t>(__builtin_return_address(0)) -
+                   reinterpret_cast<uintptr_t>(&__executable_start);
+    ++harness::sancov::pcMap[(pc ^ (pc >> 16)) & (harness::sancov::kPcMapSize - 1)];
+}
+
+} // extern "C"
+
+namespace harness {
+
+inline bool coverageAvailable() {
+    return true;
+}
+
+inline void resetCoverage() {
+    for (size_t r = 0; r < sancov::numRegions; ++r)
+        std::memset(sancov::regions[r].begin, 0, sancov::regions[r].end - sancov::regions[r].begin);
+    std::memset(sancov::pcMap, 0, sizeof(sancov::pcMap));
+}
+
+// Edge numbers forEachEdge() can report are below this.
+inline size_t coverageMapSize() {
+    size_t size = sancov::kPcMapSize;
+    for (size_t r = 0; r < sancov::numRegions; ++r)
+        size += sancov::regions[r].end - sancov::regions[r].begin;
+    return size;
+}
+
+// Calls fn(edge, count) for every edge hit since resetCoverage().
+template <class Fn>
+inline void forEachEdge(Fn fn) {
+    uint32_t base = 0;
+    for (size_t r = 0; r < sancov::numRegions; ++r) {
+        const sancov::Region &region = sancov::regions[r];
+        forEachNonZero(region.begin, region.end, base, fn);
+        base += static_cast<uint32_t>(region.end - region.begin);
+    }
+    forEachNonZero(sancov::pcMap, sancov::pcMap + sancov::kPcMapSize, base, fn);
+}
+
+} // namespace harness
+
+#else
+
+// AFL++ runtime (afl-compiler-rt), present only in instrumented builds.
+extern "C" {
+extern uint8_t *__afl_area_ptr __attribute__((weak));
+extern uint32_t __afl_final_loc __attribute__((weak));
+}
+
+namespace harness {
+
+inline size_t aflMapSize() {
+    return &__afl_final_loc && __afl_final_loc ? __afl_final_loc : size_t{1} << 16;
+}
+
+inline bool coverageAvailable() {
+    return &__afl_area_ptr && __afl_area_ptr;
+}
+
+inline size_t coverageMapSize() {
+    return aflMapSize();
+}
+
+// Under afl-fuzz (and afl-showmap) the map is the fuzzer's shared memory,
+// which it clears before every exec itself; clearing it again mid-exec
+// would drop the edges the exec has recorded so far.
+inline bool fuzzerOwnsCoverageMap() {
+    static const bool owned = std::getenv("__AFL_SHM_ID") != nullptr;
+    return owned;
+}
+
+// Outside afl-fuzz only: there the map is the runtime's private one and
+// keeps counting across execs.
+inline void resetCoverage() {
+    if (coverageAvailable() && !fuzzerOwnsCoverageMap())
+        std::memset(__afl_area_ptr, 0, aflMapSize());
+}
+
+// Edges hit since resetCoverage(), or since the exec began under afl-fuzz.
+template <class Fn>
+inline void forEachEdge(Fn fn) {
+    if (!coverageAvailable())
+        return;
+    forEachNonZero(__afl_area_ptr, __afl_area_ptr + aflMapSize(), 0, fn);
+}
+
+} // namespace harness
+
+#endif
@@ -0,0 +1,249 @@
+// Per-stage timing for the harnesses, compiled out unless -DHARNESS_PROFILE.
+//
+// Call sites wrap a stage in a StageTimer:
+//     harness::StageTimer timer(harness::Stage::Parse, json.size());
+// In a profiling build each stage gets a log2 histogram of its durations
+// (TSC cycles on x86, steady_clock nanoseconds elsewhere) plus bytes in/out.
+// The table is written at exit and whenever the process gets SIGUSR1, to
+// HARNESS_PROFILE_OUT (default stderr) as HARNESS_PROFILE_FORMAT=json (default)
+// or csv. Without HARNESS_PROFILE, StageTimer is empty and inlines away.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef HARNESS_PROFILE
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#endif
+
+namespace harness {
+
+enum class Stage : unsigned {
+    Exec,     // one whole testcase
+    Load,     // reading the testcase (stdin / file / mmap)
+    Encode,   // JsonEncoder bytes -> JSON
+    Build,    // CharReaderBuilder::newCharReader
+    Parse,    // CharReader::parse
+    Echo,     // console output
+    RoundTrip,  // StreamWriter + re-parse + compare (HARNESS_ROUNDTRIP)
+};
+
+#ifdef HARNESS_PROFILE
+
+namespace profile {
+
+constexpr unsigned kNumStages = 7;
+constexpr unsigned kNumBuckets = 65;  // bucket i: ticks in [2^(i-1), 2^i), bucket 0: 0
+constexpr const char *kStageNames[kNumStages] = {"exec", "load", "encode", "build", "parse", "echo",
+                                                           "roundtrip"};
+
+#if defined(__x86_64__) || defined(__i386__)
+constexpr const char *kClock = "tsc";
+inline uint64_t ticks() {
+    return __rdtsc();
+}
+#else
+constexpr const char *kClock = "ns";
+inline uint64_t ticks() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+#endif
+
+struct Histogram {
+    uint64_t count = 0;
+    uint64_t total = 0;
+    uint64_t bytesIn = 0;
+    uint64_t bytesOut = 0;
+    uint64_t buckets[kNumBuckets] = {};
+
+    void add(uint64_t t, uint64_t in, uint64_t out) {
+        ++count;
+        total += t;
+        bytesIn += in;
+        bytesOut += out;
+        ++buckets[t ? 64 - __builtin_clzll(t) : 0];
+    }
+
+    // Upper bound of the bucket holding the q-quantile
+    uint64_t quantile(double q) const {
+        uint64_t rank = static_cast<uint64_t>(q * count);
+        uint64_t seen = 0;
+        for (unsigned i = 0; i < kNumBuckets; ++i) {
+            seen += buckets[i];
+            if (seen > rank)
+                return i ? (i == 64 ? UINT64_MAX : (uint64_t{1} << i) - 1) : 0;
+        }
+        return 0;
+    }
+};
+
+class Profile {
+public:
+    Profile() {
+        std::signal(SIGUSR1, onSignal);
+    }
+    Profile(const Profile &) = delete;
+    Profile &operator=(const Profile &) = delete;
+
+    ~Profile() {
+        dump();
+    }
+
+    void add(Stage stage, uint64_t t, uint64_t in, uint64_t out) {
+        stages_[static_cast<unsigned>(stage)].add(t, in, out);
+    }
+
+    // Writes the table if SIGUSR1 arrived since the last call. Called
+    // between testcases, where writing is safe.
+    void poll() {
+        if (dumpRequested_) {
+            dumpRequested_ = 0;
+            dump();
+        }
+    }
+
+    void dump() const {
+        const char *path = std::getenv("HARNESS_PROFILE_OUT");
+        const char *format = std::getenv("HARNESS_PROFILE_FORMAT");
+        FILE *f = path ? std::fopen(path, "w") : stderr;
+        if (!f) {
+            std::fprintf(stderr, "[harness] cannot write %s\n", path);
+            return;
+        }
+        if (format && std::strcmp(format, "csv") == 0)
+            dumpCsv(f);
+        else
+            dumpJson(f);
+        if (f != stderr)
+            std::fclose(f);
+        else
+            std::fflush(f);
+    }
+
+private:
+    static void onSignal(int) {
+        dumpRequested_ = 1;
+    }
+
+    void dumpJson(FILE *f) const {
+        std::fprintf(f, "{\"clock\": \"%s\", \"stages\": {", kClock);
+        for (unsigned s = 0; s < kNumStages; ++s) {
+            const Histogram &h = stages_[s];
+            std::fprintf(f, "%s\n  \"%s\": {\"count\": %llu, \"total\": %llu, \"bytes_in\": %llu, "
+                            "\"bytes_out\": %llu, \"p50\": %llu, \"p99\": %llu, \"histogram\": [",
+                         s ? "," : "", kStageNames[s],
+                         static_cast<unsigned long long>(h.count),
+                         static_cast<unsigned long long>(h.total),
+                         static_cast<unsigned long long>(h.bytesIn),
+                         static_cast<unsigned long long>(h.bytesOut),
+                         static_cast<unsigned long long>(h.quantile(0.5)),
+                         static_cast<unsigned long long>(h.quantile(0.99)));
+            // [bucket upper bound exponent, count] for the non-empty buckets
+            bool first = true;
+            for (unsigned i = 0; i < kNumBuckets; ++i) {
+                if (!h.buckets[i])
+                    continue;
+                std::fprintf(f, "%s[%u, %llu]", first ? "" : ", ", i,
+                             static_cast<unsigned long long>(h.buckets[i]));
+                first = false;
+            }
+            std::fprintf(f, "]}");
+        }
+        std::fprintf(f, "\n}}\n");
+    }
+
+    void dumpCsv(FILE *f) const {
+        // histogram: log2-bucket:count pairs separated by ';'
+        std::fprintf(f, "stage,clock,count,total,bytes_in,bytes_out,p50,p99,histogram\n");
+        for (unsigned s = 0; s < kNumStages; ++s) {
+            const Histogram &h = stages_[s];
+            std::fprintf(f, "%s,%s,%llu,%llu,%llu,%llu,%llu,%llu,", kStageNames[s], kClock,
+                         static_cast<unsigned long long>(h.count),
+                         static_cast<unsigned long long>(h.total),
+                         static_cast<unsigned long long>(h.bytesIn),
+                         static_cast<unsigned long long>(h.bytesOut),
+                         static_cast<unsigned long long>(h.quantile(0.5)),
+                         static_cast<unsigned long long>(h.quantile(0.99)));
+            bool first = true;
+            for (unsigned i = 0; i < kNumBuckets; ++i) {
+                if (!h.buckets[i])
+                    continue;
+                std::fprintf(f, "%s%u:%llu", first ? "" : ";", i,
+                             static_cast<unsigned long long>(h.buckets[i]));
+                first = false;
+            }
+            std::fprintf(f, "\n");
+        }
+    }
+
+    Histogram stages_[kNumStages];
+    static inline volatile std::sig_atomic_t dumpRequested_ = 0;
+};
+
+inline Profile &profile() {
+    static Profile p;
+    return p;
+}
+
+} // namespace profile
+
+class StageTimer {
+public:
+    explicit StageTimer(Stage stage, size_t bytesIn = 0)
+        : stage_(stage), bytesIn_(bytesIn), start_(profile::ticks()) {}
+    StageTimer(const StageTimer &) = delete;
+    StageTimer &operator=(const StageTimer &) = delete;
+
+    ~StageTimer() {
+        profile::profile().add(stage_, profile::ticks() - start_, bytesIn_, bytesOut_);
+    }
+
+    void bytesIn(size_t n) {
+        bytesIn_ = n;
+    }
+
+    void bytesOut(size_t n) {
+        bytesOut_ = n;
+    }
+
+private:
+    Stage stage_;
+    uint64_t bytesIn_;
+    uint64_t bytesOut_ = 0;
+    uint64_t start_;
+};
+
+// Sets up the profile (and its SIGUSR1 handler) before the first testcase.
+inline void profileInit() {
+    profile::profile();
+}
+
+inline void profilePoll() {
+    profile::profile().poll();
+}
+
+#else
+
+class StageTimer {
+public:
+    explicit StageTimer(Stage, size_t = 0) {}
+    StageTimer(const StageTimer &) = delete;
+    StageTimer &operator=(const StageTimer &) = delete;
+    void bytesIn(size_t) {}
+    void bytesOut(size_t) {}
+};
+
+inline void profileInit() {}
+inline void profilePoll() {}
+
+#endif
+
+} // namespace harness
@@ -0,0 +1,163 @@
+// Differential round trip for the harnesses, compiled in with
+// -DHARNESS_ROUNDTRIP.
+//
+// After a successful parse, roundTrip(root) serializes root with a
+// StreamWriter, parses that text again and compares the two trees; any
+// difference is a reader/writer asymmetry and aborts, so the fuzzer records
+// the testcase as a crash. The writer, its output buffer, the second reader
+// and the second Json::Value live for the whole process: a check costs a
+// serialize and a parse, not a round of allocations.
+//
+// The writer emits UTF-8 unescaped so bytes the reader accepted come back
+// as they were, Infinity/NaN by name for allowSpecialFloats, and 17
+// significant digits so every double survives. The second reader accepts
+// exactly what that writer produces. NaN compares equal to NaN.
+// Without HARNESS_ROUNDTRIP, roundTrip() is empty and inlines away.
+#pragma once
+
+#include "harness_profile.h"
+
+#ifdef HARNESS_ROUNDTRIP
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <utility>
+#include <vector>
+#include <jsoncpp/json/json.h>
+#endif
+
+namespace harness {
+
+#ifdef HARNESS_ROUNDTRIP
+
+// Stream output into a std::string whose capacity is kept across writes,
+// unlike std::ostringstream::str("").
+class StringSink : public std::streambuf {
+public:
+    std::string text;
+
+protected:
+    int_type overflow(int_type c) override {
+        if (!traits_type::eq_int_type(c, traits_type::eof()))
+            text.push_back(traits_type::to_char_type(c));
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char *s, std::streamsize n) override {
+        text.append(s, static_cast<size_t>(n));
+        return n;
+    }
+};
+
+class RoundTrip {
+public:
+    RoundTrip() : out_(&sink_) {
+        Json::StreamWriterBuilder writer;
+        writer["indentation"] = "";
+        writer["commentStyle"] = "None";
+        writer["emitUTF8"] = true;
+        writer["useSpecialFloats"] = true;
+        writer["precision"] = 17;
+        writer_.reset(writer.newStreamWriter());
+
+        Json::CharReaderBuilder reader;
+        reader["allowSpecialFloats"] = true;
+        // Nesting is bounded by the parse that built root
+        reader["stackLimit"] = 1 << 20;
+        reader_.reset(reader.newCharReader());
+    }
+    RoundTrip(const RoundTrip &) = delete;
+    RoundTrip &operator=(const RoundTrip &) = delete;
+
+    void check(const Json::Value &root) {
+        StageTimer timer(Stage::RoundTrip);
+        sink_.text.clear();
+        writer_->write(root, &out_);
+        const std::string &text = sink_.text;
+        timer.bytesOut(text.size());
+
+        bool ok;
+        errs_.clear();
+        try {
+            ok = reader_->parse(text.data(), text.data() + text.size(), &again_, &errs_);
+        } catch (const Json::Exception &e) {
+            ok = false;
+            errs_ = e.what();
+        }
+        if (!ok) {
+            fail("writer output does not parse", errs_.c_str());
+        } else if (!same(root, again_)) {
+            fail("re-parsed value differs", "");
+        }
+    }
+
+private:
+    static bool sameScalar(const Json::Value &a, const Json::Value &b) {
+        if (a.type() == Json::realValue && b.type() == Json::realValue &&
+            std::isnan(a.asDouble()) && std::isnan(b.asDouble()))
+            return true;
+        return a == b;
+    }
+
+    // Json::Value::operator== with NaN == NaN, walked with an explicit stack
+    // since documents nest far deeper than is safe to recurse on.
+    bool same(const Json::Value &a, const Json::Value &b) {
+        stack_.clear();
+        stack_.emplace_back(&a, &b);
+        while (!stack_.empty()) {
+            const Json::Value &x = *stack_.back().first;
+            const Json::Value &y = *stack_.back().second;
+            stack_.pop_back();
+            if (x.type() != y.type() || x.size() != y.size())
+                return false;
+            if (x.type() == Json::arrayValue) {
+                for (Json::ArrayIndex i = 0; i < x.size(); ++i)
+                    stack_.emplace_back(&x[i], &y[i]);
+            } else if (x.type() == Json::objectValue) {
+                for (auto it = x.begin(); it != x.end(); ++it) {
+                    const char *end;
+                    const char *name = it.memberName(&end);
+                    const Json::Value *other = y.find(name, end);
+                    if (!other)
+                        return false;
+                    stack_.emplace_back(&*it, other);
+                }
+            } else if (!sameScalar(x, y)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    [[noreturn]] void fail(const char *what, const char *detail) {
+        constexpr int kMaxShown = 4096;
+        std::fprintf(stderr, "[harness] round trip failed: %s %s\n[harness] writer output (%zu bytes): %.*s\n",
+                     what, detail, sink_.text.size(), kMaxShown, sink_.text.c_str());
+        std::abort();
+    }
+
+    StringSink sink_;
+    std::ostream out_;
+    std::unique_ptr<Json::StreamWriter> writer_;
+    std::unique_ptr<Json::CharReader> reader_;
+    Json::Value again_;
+    std::string errs_;
+    std::vector<std::pair<const Json::Value *, const Json::Value *>> stack_;
+};
+
+inline void roundTrip(const Json::Value &root) {
+    static RoundTrip check;
+    check.check(root);
+}
+
+#else
+
+inline void roundTrip(const Json::Value &) {}
+
+#endif
+
+} // namespace harness
@@ -0,0 +1,204 @@
+// Live coverage export for campaigns, switched on at run time with
+// HARNESS_COV_SNAPSHOT=FILE in a build with a coverage source (afl-clang-fast,
+// or -DHARNESS_SANCOV with trace-pc-guard / inline-8bit-counters; see
+// harness_cov.h).
+//
+// FILE is a MAP_SHARED bitset of every edge any exec has reached, behind a
+// SnapshotHeader. After each exec the edges hit (forEachEdge) are OR'd in
+// with atomic word ORs, so forkserver children, persistent-mode loops and
+// parallel -S instances of the same binary can all share one file. A
+// process only writes a word when it sets a new bit in it, and adds its
+// exec count in batches, so the shared cache lines stay quiet.
+//
+// Every HARNESS_COV_INTERVAL seconds (default 5) one process appends
+//     relative_time, unix_time, execs, edges
+// to FILE.csv, as afl-fuzz does to plot_data; plot_coverage_fast.py
+// --snapshots plots it without replaying the queue. The bitset keeps edges
+// only, not hit counts: new buckets of old edges do not show.
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "harness_cov.h"
+
+namespace harness {
+
+struct SnapshotHeader {
+    static constexpr char kMagic[8] = {'H', 'C', 'O', 'V', 'S', 'N', 'P', '1'};
+
+    char magic[8];
+    uint32_t mapSize;        // bits in the bitset that follows
+    uint32_t reserved;
+    uint64_t createdNs;      // CLOCK_REALTIME of the first process
+    uint64_t execs;          // all processes; batched, so slightly behind
+    uint64_t edges;          // bits set
+    uint64_t lastCsvNs;      // last FILE.csv row
+    uint64_t pad[2];
+};
+static_assert(sizeof(SnapshotHeader) == 64, "bitset starts on a cache line");
+
+inline uint64_t realtimeNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000u + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+class CoverageSnapshot {
+public:
+    CoverageSnapshot() = default;
+    CoverageSnapshot(const CoverageSnapshot &) = delete;
+    CoverageSnapshot &operator=(const CoverageSnapshot &) = delete;
+
+    ~CoverageSnapshot() {
+        if (header_)
+            maybeWriteRow();   // forkserver children may run a single exec
+    }
+
+    // Maps HARNESS_COV_SNAPSHOT, creating it if needed. Call before the
+    // fork point so every child inherits the mapping.
+    void open() {
+        if (opened_)
+            return;
+        opened_ = true;
+        const char *path = std::getenv("HARNESS_COV_SNAPSHOT");
+        if (!path || !*path)
+            return;
+        if (!coverageAvailable()) {
+            std::fprintf(stderr, "[harness] HARNESS_COV_SNAPSHOT needs an afl-clang-fast or "
+                                 "-DHARNESS_SANCOV build; ignoring it\n");
+            return;
+        }
+        if (const char *interval = std::getenv("HARNESS_COV_INTERVAL"))
+            intervalNs_ = static_cast<uint64_t>(std::strtod(interval, nullptr) * 1e9);
+
+        const size_t mapSize = coverageMapSize();
+        const size_t words = (mapSize + 63) / 64;
+        const size_t bytes = sizeof(SnapshotHeader) + words * sizeof(uint64_t);
+        int fd = ::open(path, O_RDWR | O_CREAT, 0644);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0) {
+            std::fprintf(stderr, "[harness] cannot open %s: %s\n", path, std::strerror(errno));
+            if (fd >= 0)
+                close(fd);
+            return;
+        }
+        // A new file reads as zeros once extended; a racing creator is fine
+        if (static_cast<size_t>(st.st_size) < bytes && ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+            std::fprintf(stderr, "[harness] cannot size %s: %s\n", path, std::strerror(errno));
+            close(fd);
+            return;
+        }
+        void *region = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (region == MAP_FAILED) {
+            std::fprintf(stderr, "[harness] cannot map %s: %s\n", path, std::strerror(errno));
+            return;
+        }
+
+        SnapshotHeader *header = static_cast<SnapshotHeader *>(region);
+        uint32_t expected = 0;
+        if (__atomic_compare_exchange_n(&header->mapSize, &expected, static_cast<uint32_t>(mapSize), false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            std::memcpy(header->magic, SnapshotHeader::kMagic, sizeof(header->magic));
+            __atomic_store_n(&header->createdNs, realtimeNs(), __ATOMIC_RELEASE);
+        } else if (std::memcmp(header->magic, SnapshotHeader::kMagic, sizeof(header->magic)) != 0 &&
+                   __atomic_load_n(&header->createdNs, __ATOMIC_ACQUIRE) != 0) {
+            std::fprintf(stderr, "[harness] %s is not a coverage snapshot; ignoring it\n", path);
+            munmap(region, bytes);
+            return;
+        } else if (expected != mapSize) {
+            std::fprintf(stderr, "[harness] %s holds a %u-edge map, this build has %zu edges; ignoring it\n",
+                         path, expected, mapSize);
+            munmap(region, bytes);
+            return;
+        }
+        header_ = header;
+        bits_ = reinterpret_cast<uint64_t *>(header + 1);
+        mapSize_ = mapSize;
+        csvPath_ = std::string(path) + ".csv";
+    }
+
+    bool enabled() const {
+        return header_ != nullptr;
+    }
+
+    // After each exec: adds the edges it reached, and every interval a row.
+    void update() {
+        if (!header_)
+            return;
+        forEachEdge([&](uint32_t edge, uint8_t) {
+            if (edge >= mapSize_)
+                return;
+            uint64_t bit = uint64_t{1} << (edge % 64);
+            uint64_t *word = &bits_[edge / 64];
+            if (__atomic_load_n(word, __ATOMIC_RELAXED) & bit)
+                return;
+            if (!(__atomic_fetch_or(word, bit, __ATOMIC_RELAXED) & bit))
+                __atomic_fetch_add(&header_->edges, 1, __ATOMIC_RELAXED);
+        });
+        if (++pendingExecs_ % kExecsPerClockCheck == 0)
+            maybeWriteRow();
+    }
+
+private:
+    static constexpr uint64_t kExecsPerClockCheck = 256;
+
+    void flushExecs() {
+        __atomic_fetch_add(&header_->execs, pendingExecs_, __ATOMIC_RELAXED);
+        pendingExecs_ = 0;
+    }
+
+    void maybeWriteRow() {
+        flushExecs();
+        uint64_t now = realtimeNs();
+        uint64_t last = __atomic_load_n(&header_->lastCsvNs, __ATOMIC_RELAXED);
+        if (now - last < intervalNs_ ||
+            !__atomic_compare_exchange_n(&header_->lastCsvNs, &last, now, false, __ATOMIC_ACQ_REL,
+                                         __ATOMIC_RELAXED))
+            return;
+        int fd = ::open(csvPath_.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd < 0)
+            return;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size == 0) {
+            const char header[] = "# relative_time, unix_time, execs, edges\n";
+            ssize_t ignored = write(fd, header, sizeof(header) - 1);
+            (void)ignored;
+        }
+        char row[128];
+        uint64_t created = __atomic_load_n(&header_->createdNs, __ATOMIC_ACQUIRE);
+        int n = std::snprintf(row, sizeof(row), "%.3f, %llu, %llu, %llu\n", (now - created) / 1e9,
+                              static_cast<unsigned long long>(now / 1000000000u),
+                              static_cast<unsigned long long>(__atomic_load_n(&header_->execs, __ATOMIC_RELAXED)),
+                              static_cast<unsigned long long>(__atomic_load_n(&header_->edges, __ATOMIC_RELAXED)));
+        // One O_APPEND write per row, so rows from several processes never mix
+        ssize_t ignored = write(fd, row, static_cast<size_t>(n));
+        (void)ignored;
+        close(fd);
+    }
+
+    SnapshotHeader *header_ = nullptr;
+    uint64_t *bits_ = nullptr;
+    size_t mapSize_ = 0;
+    uint64_t pendingExecs_ = 0;
+    uint64_t intervalNs_ = 5000000000u;
+    std::string csvPath_;
+    bool opened_ = false;
+};
+
+inline CoverageSnapshot &coverageSnapshot() {
+    static CoverageSnapshot snapshot;
+    return snapshot;
+}
+
+} // namespace harness
@@ -0,0 +1,390 @@
+// Token-level testcase minimizer for the encoder harnesses (main2.cpp,
+// main3.cpp): `harness --tmin [--timeout-ms MS] IN OUT`.
+//
+// afl-tmin edits bytes, and almost any byte edit to encoder input shifts
+// every later token (value bytes pack a token and a member count), so most
+// of its candidates are unrelated documents. This minimizer edits the
+// encoder's own node layout (JsonEncoder::describe) instead, with edits that
+// keep every other node decoding as before:
+//   - drop documents, halving chunks first (ddmin);
+//   - cut bytes past where the encoder stopped reading a document;
+//   - replace a subtree with null;
+//   - replace a container with one of its members (hoist);
+//   - drop all of a container's members, then single members, lowering its
+//     count bits to match (members past the end of the input, which decode
+//     from zero padding, go first);
+//   - set object keys to key token 0 and clear reader option bits.
+// Rounds repeat until none of them shrinks the testcase. Each candidate runs
+// runTestcase in a forked child of this already initialised process (reader
+// cache built, token weights loaded), which "crashes" if it dies the same way
+// IN did: the same signal, or the same non-zero exit status for sanitizers
+// that exit. A child still running after MS ms (default 1000) is killed with
+// SIGALRM, so hangs minimize too. The child's stdout and stderr are dropped.
+#pragma once
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "harness.h"
+#include "json_encoder.h"
+
+namespace harness {
+namespace tmin {
+
+constexpr size_t kNullToken = 2;   // "null" in json_tokens::kGeneralTokens
+using Node = JsonEncoder::Node;
+
+// A testcase split the way runTestcase reads it.
+struct Testcase {
+    std::string header;             // option bytes, if the harness has any
+    std::vector<std::string> docs;  // encoder inputs, in order
+
+    // Joined under HARNESS_FRAMING, or false if a document cannot be framed
+    // (a '\n' inside a line, a length byte overflow).
+    bool assemble(std::string &out) const {
+        out = header;
+        for (const std::string &doc : docs) {
+#if HARNESS_FRAMING == HARNESS_FRAMING_LINES
+            if (doc.find('\n') != std::string::npos)
+                return false;
+            out += doc;
+            out += '\n';
+#elif HARNESS_FRAMING == HARNESS_FRAMING_LENGTH
+            if (doc.size() > 0xff)
+                return false;
+            out += static_cast<char>(doc.size());
+            out += doc;
+#else
+            out += doc;
+#endif
+        }
+        return true;
+    }
+
+    static Testcase split(const std::string &bytes, size_t headerSize) {
+        Testcase t;
+        t.header = bytes.substr(0, headerSize);
+        if (bytes.size() <= headerSize)
+            return t;
+        const char *text = bytes.data();
+        forEachDocument(text + headerSize, text + bytes.size(), [&](const char *p, const char *docEnd) {
+            JsonEncoder enc(reinterpret_cast<const uint8_t *>(p), docEnd - p, ENCODER_MAX_DEPTH, ENCODER_MAX_NODES);
+            enc.extent();
+#if HARNESS_FRAMING == HARNESS_FRAMING_STREAM
+            // Here a document is what the encoder read; the rest is the next one
+            if (enc.consumed() != 0)
+                docEnd = p + std::min<size_t>(enc.consumed(), docEnd - p);
+#endif
+            t.docs.emplace_back(p, docEnd);
+            return enc.consumed();
+        });
+        return t;
+    }
+};
+
+// How a child process ended: -signal, or its exit status.
+inline int runChild(const std::string &bytes, unsigned timeoutMs) {
+    std::fflush(stdout);
+    std::fflush(stderr);
+    pid_t pid = fork();
+    if (pid < 0) {
+        std::fprintf(stderr, "[harness] tmin: fork failed: %s\n", std::strerror(errno));
+        std::exit(1);
+    }
+    if (pid == 0) {
+        int null = open("/dev/null", O_WRONLY);
+        if (null >= 0) {
+            dup2(null, STDOUT_FILENO);
+            dup2(null, STDERR_FILENO);
+            close(null);
+        }
+        struct itimerval timeout = {{0, 0}, {static_cast<time_t>(timeoutMs / 1000),
+                                             static_cast<suseconds_t>(timeoutMs % 1000 * 1000)}};
+        setitimer(ITIMER_REAL, &timeout, nullptr);
+        execute(reinterpret_cast<const uint8_t *>(bytes.data()), bytes.size());
+        std::fflush(stdout);
+        _exit(0);
+    }
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    return WIFSIGNALED(status) ? -WTERMSIG(status) : WEXITSTATUS(status);
+}
+
+class Minimizer {
+public:
+    Minimizer(std::string bytes, size_t headerSize, unsigned timeoutMs)
+        : bytes_(std::move(bytes)), headerSize_(headerSize), timeoutMs_(timeoutMs) {
+        const json_tokens::ValueMap &map = JsonEncoder::valueMap();
+        for (size_t slot = 0; slot < json_tokens::kNumValueSlots && !haveNull_; ++slot) {
+            if (map[slot << 3] == kNullToken) {
+                nullByte_ = static_cast<char>(slot << 3);
+                haveNull_ = true;
+            }
+        }
+    }
+
+    // How IN ends; 0 means it does not crash.
+    int start() {
+        signature_ = runChild(bytes_, timeoutMs_);
+        ++execs_;
+        return signature_;
+    }
+
+    void run() {
+        for (size_t before = SIZE_MAX; bytes_.size() < before;) {
+            before = bytes_.size();
+            dropDocuments();
+            trimDocuments();
+            for (size_t d = 0; d < current().docs.size(); ++d)
+                reduceNodes(d);
+            normalize();
+        }
+    }
+
+    const std::string &bytes() const {
+        return bytes_;
+    }
+    size_t execs() const {
+        return execs_;
+    }
+    size_t tried() const {
+        return tried_;
+    }
+
+    static size_t countNodes(const Testcase &t) {
+        size_t nodes = 0;
+        for (const std::string &doc : t.docs) {
+            JsonEncoder enc(reinterpret_cast<const uint8_t *>(doc.data()), doc.size(),
+                            ENCODER_MAX_DEPTH, ENCODER_MAX_NODES);
+            nodes += enc.extent().nodes;
+        }
+        return nodes;
+    }
+
+    Testcase current() const {
+        return Testcase::split(bytes_, headerSize_);
+    }
+
+private:
+    // Keeps candidate if it is no larger, differs, and crashes the same way.
+    bool attempt(const Testcase &candidate) {
+        std::string bytes;
+        ++tried_;
+        if (!candidate.assemble(bytes) || bytes.size() > bytes_.size() || bytes == bytes_)
+            return false;
+        ++execs_;
+        if (runChild(bytes, timeoutMs_) != signature_)
+            return false;
+        bytes_ = std::move(bytes);
+        return true;
+    }
+
+    void dropDocuments() {
+        Testcase t = current();
+        for (size_t chunk = t.docs.size() / 2; chunk >= 1; chunk /= 2) {
+            for (size_t at = 0; at < t.docs.size() && t.docs.size() > 1;) {
+                Testcase candidate = t;
+                size_t n = std::min(chunk, candidate.docs.size() - at);
+                candidate.docs.erase(candidate.docs.begin() + at, candidate.docs.begin() + at + n);
+                if (!candidate.docs.empty() && attempt(candidate))
+                    t = current();
+                else
+                    at += n;
+            }
+        }
+    }
+
+    void trimDocuments() {
+#if HARNESS_FRAMING != HARNESS_FRAMING_STREAM
+        Testcase t = current();
+        bool cut = false;
+        for (std::string &doc : t.docs) {
+            JsonEncoder enc(reinterpret_cast<const uint8_t *>(doc.data()), doc.size(),
+                            ENCODER_MAX_DEPTH, ENCODER_MAX_NODES);
+            enc.extent();
+            if (enc.consumed() < doc.size()) {
+                doc.resize(enc.consumed() ? enc.consumed() : 1);
+                cut = true;
+            }
+        }
+        if (cut)
+            attempt(t);
+#endif
+    }
+
+    // Same document with [begin, end) replaced; count bits of the byte at
+    // `container` (if any) lowered by `dropped`.
+    bool edit(size_t d, size_t begin, size_t end, const std::string &with,
+              size_t container = SIZE_MAX, unsigned dropped = 0) {
+        Testcase t = current();
+        std::string &doc = t.docs[d];
+        if (container != SIZE_MAX) {
+            uint8_t b = static_cast<uint8_t>(doc[container]);
+            doc[container] = static_cast<char>((b & ~0x07u) | ((b & 0x07u) - dropped));
+        }
+        doc.replace(begin, end - begin, with);
+        return attempt(t);
+    }
+
+    // Top-down over one document: the first edit to succeed on a node is
+    // kept and the node tried again, since it now holds something smaller.
+    void reduceNodes(size_t d) {
+        for (size_t i = 0;; ++i) {
+            for (bool again = true; again;) {
+                again = false;
+                Testcase t = current();
+                if (d >= t.docs.size())
+                    return;
+                const std::string &doc = t.docs[d];
+                JsonEncoder enc(reinterpret_cast<const uint8_t *>(doc.data()), doc.size(),
+                                ENCODER_MAX_DEPTH, ENCODER_MAX_NODES);
+                nodes_.clear();
+                enc.describe(nodes_);
+                if (i >= nodes_.size())
+                    return;
+                again = reduceNode(d, i);
+            }
+        }
+    }
+
+    bool reduceNode(size_t d, size_t i) {
+        const Node n = nodes_[i];
+        if (n.begin >= n.end)
+            return false;   // zero padding past the end of the input
+        bool container = n.kind != json_tokens::Kind::Scalar;
+        bool isNull = !container && JsonEncoder::valueMap()[static_cast<uint8_t>(current().docs[d][n.begin])] == kNullToken;
+        if (haveNull_ && (container || !isNull) && edit(d, n.begin, n.end, std::string(1, nullByte_)))
+            return true;
+        if (!container)
+            return false;
+
+        // Members the input ran out for (zero padding) come last and cost no
+        // bytes, but still count as nodes
+        std::vector<Node> members;
+        unsigned padding = 0;
+        for (size_t c = i + 1; c < nodes_.size(); ++c) {
+            if (nodes_[c].parent != i)
+                continue;
+            if (nodes_[c].begin < nodes_[c].end)
+                members.push_back(nodes_[c]);
+            else
+                ++padding;
+        }
+        if (padding && edit(d, n.end, n.end, "", n.begin, padding))
+            return true;
+        const std::string doc = current().docs[d];
+        for (const Node &m : members) {
+            if (edit(d, n.begin, n.end, doc.substr(m.begin, m.end - m.begin)))
+                return true;
+        }
+        if (n.count > 1 && !members.empty() && edit(d, n.begin + 1, n.end, "", n.begin, n.count))
+            return true;
+        for (size_t k = members.size(); k-- > 0;) {
+            const Node &m = members[k];
+            size_t begin = m.keyPos != Node::kNone ? m.keyPos : m.begin;
+            if (edit(d, begin, m.end, "", n.begin, 1))
+                return true;
+        }
+        return false;
+    }
+
+    // Smallest key token, fewest reader options: same size, easier to read.
+    void normalize() {
+        for (size_t d = 0; d < current().docs.size(); ++d) {
+            Testcase t = current();
+            const std::string &doc = t.docs[d];
+            JsonEncoder enc(reinterpret_cast<const uint8_t *>(doc.data()), doc.size(),
+                            ENCODER_MAX_DEPTH, ENCODER_MAX_NODES);
+            nodes_.clear();
+            enc.describe(nodes_);
+            for (const Node &n : nodes_) {
+                if (n.keyPos != Node::kNone && n.keyPos < doc.size() && doc[n.keyPos] != 0) {
+                    Testcase candidate = current();
+                    candidate.docs[d][n.keyPos] = 0;
+                    attempt(candidate);
+                }
+            }
+        }
+        for (size_t byte = 0; byte < headerSize_ && byte < bytes_.size(); ++byte) {
+            for (unsigned bit = 0; bit < 8; ++bit) {
+                Testcase candidate = current();
+                if (candidate.header[byte] & (1 << bit)) {
+                    candidate.header[byte] = static_cast<char>(candidate.header[byte] & ~(1 << bit));
+                    attempt(candidate);
+                }
+            }
+        }
+    }
+
+    std::string bytes_;
+    size_t headerSize_;
+    unsigned timeoutMs_;
+    int signature_ = 0;
+    size_t execs_ = 0;
+    size_t tried_ = 0;
+    char nullByte_ = 0;
+    bool haveNull_ = false;
+    std::vector<Node> nodes_;
+};
+
+} // namespace tmin
+
+// --tmin [--timeout-ms MS] IN OUT, for a harness whose testcases start with
+// headerSize option bytes.
+inline int tokenMinimizeMain(int argc, char **argv, size_t headerSize) {
+    unsigned timeoutMs = 1000;
+    int i = 2;
+    if (i + 1 < argc && std::strcmp(argv[i], "--timeout-ms") == 0) {
+        timeoutMs = static_cast<unsigned>(std::strtoul(argv[i + 1], nullptr, 10));
+        i += 2;
+    }
+    if (argc - i != 2) {
+        std::fprintf(stderr, "usage: %s --tmin [--timeout-ms MS] IN OUT\n", argv[0]);
+        return 1;
+    }
+    Input input;
+    if (!input.open(argv[i])) {
+        std::fprintf(stderr, "[harness] cannot open %s: %s\n", argv[i], std::strerror(errno));
+        return 1;
+    }
+    readerCache().prebuild();
+
+    std::string original(reinterpret_cast<const char *>(input.data()), input.size());
+    tmin::Minimizer minimizer(original, headerSize, timeoutMs);
+    int signature = minimizer.start();
+    if (signature == 0) {
+        std::fprintf(stderr, "[harness] tmin: %s does not crash\n", argv[i]);
+        return 1;
+    }
+    const tmin::Testcase before = minimizer.current();
+    minimizer.run();
+    const tmin::Testcase after = minimizer.current();
+
+    FILE *out = std::fopen(argv[i + 1], "wb");
+    if (!out || std::fwrite(minimizer.bytes().data(), 1, minimizer.bytes().size(), out) != minimizer.bytes().size()) {
+        std::fprintf(stderr, "[harness] cannot write %s: %s\n", argv[i + 1], std::strerror(errno));
+        if (out)
+            std::fclose(out);
+        return 1;
+    }
+    std::fclose(out);
+    std::fprintf(stderr,
+                 "[harness] tmin: %s %d; %zu -> %zu bytes, %zu -> %zu documents, %zu -> %zu nodes "
+                 "in %zu execs (%zu candidates)\n",
+                 signature < 0 ? "signal" : "exit status", signature < 0 ? -signature : signature,
+                 original.size(), minimizer.bytes().size(), before.docs.size(), after.docs.size(),
+                 tmin::Minimizer::countNodes(before), tmin::Minimizer::countNodes(after),
+                 minimizer.execs(), minimizer.tried());
+    return 0;
+}
+
+} // namespace harness
@@ -0,0 +1,760 @@
+// JsonEncoder: turns arbitrary fuzzer bytes into one syntactically valid JSON
+// value. Shared by the encoder harnesses (main2.cpp, main3.cpp).
+// CompactEncoder reads the same grammar from the compact v1 layout
+// (json_format::Compact, main5.cpp).
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// The encoder grammar as compile-time tables. A fuzzer byte selects a token
+// through one lookup (kValueTokenOf / kKeyTokenOf), and emission is a single
+// memcpy of the token text. Adding or re-weighting tokens only touches the
+// tables, never the encoder's control flow; makeWeightedValueTokenOf builds
+// a re-weighted value table that JsonEncoder::setValueMap installs.
+namespace json_tokens {
+
+enum class Kind : uint8_t { Scalar, Array, Object };
+
+struct Token {
+    const char *text;
+    uint8_t length;
+    Kind kind;
+};
+
+template <size_t N>
+constexpr Token literal(const char (&text)[N]) {
+    return Token{text, static_cast<uint8_t>(N - 1), Kind::Scalar};
+}
+
+// 14 string tokens, used for keys and as string values
+constexpr std::array<Token, 14> kStringTokens = {{
+    literal("\"a\""),
+    literal("\"A\""),
+    literal("\"!\""),
+    literal("\"\\\"\""),       // string containing a double quote: "\""
+    literal("\"'\""),          // single quote
+    literal("\"0\""),
+    literal("\"Cool1\""),
+    literal("\"2Cool!\""),
+    literal("\"!Yay?\""),
+    literal("\"\\b\""),        // backspace escape
+    literal("\"\\r\""),        // carriage return escape
+    literal("\"\\u0000\""),    // explicit null char
+    literal("\"\\n\""),        // newline escape (NOT raw 0x0A)
+    literal("\" \""),          // space inside string
+}};
+
+// 25 general tokens:
+//  - 0..2   : false, true, null
+//  - 3..16  : string literals (same set as key strings)
+//  - 17..22 : numbers
+//  - 23     : array ([...])
+//  - 24     : object ({...})
+constexpr std::array<Token, 25> kGeneralTokens = {{
+    literal("false"), literal("true"), literal("null"),
+    kStringTokens[0], kStringTokens[1], kStringTokens[2], kStringTokens[3],
+    kStringTokens[4], kStringTokens[5], kStringTokens[6], kStringTokens[7],
+    kStringTokens[8], kStringTokens[9], kStringTokens[10], kStringTokens[11],
+    kStringTokens[12], kStringTokens[13],
+    literal("0"), literal("1"), literal("-1"),
+    literal("+0"),   // if JsonCpp rejects +0 as number, turn this into "\"+0\"" instead
+    literal("-0"),
+    literal("+3"),   // same note as +0
+    Token{"", 0, Kind::Array},
+    Token{"", 0, Kind::Object},
+}};
+
+constexpr size_t kNumGeneralTokens = kGeneralTokens.size();
+constexpr size_t kNumStringTokens = kStringTokens.size();
+
+// kGeneralTokens index of the (first) token of a kind, e.g. the array token.
+constexpr size_t tokenOfKind(Kind kind) {
+    for (size_t t = 0; t < kNumGeneralTokens; ++t) {
+        if (kGeneralTokens[t].kind == kind)
+            return t;
+    }
+    return 0;
+}
+
+// Value byte: upper 5 bits pick the token (folded onto the 25 tokens),
+// lower 3 bits are the size of an array/object.
+constexpr std::array<uint8_t, 256> makeValueTokenOf() {
+    std::array<uint8_t, 256> table{};
+    for (size_t b = 0; b < table.size(); ++b)
+        table[b] = static_cast<uint8_t>((b >> 3) % kNumGeneralTokens);
+    return table;
+}
+
+// Key byte: the whole byte picks one of the string tokens.
+constexpr std::array<uint8_t, 256> makeKeyTokenOf() {
+    std::array<uint8_t, 256> table{};
+    for (size_t b = 0; b < table.size(); ++b)
+        table[b] = static_cast<uint8_t>(b % kNumStringTokens);
+    return table;
+}
+
+constexpr std::array<uint8_t, 256> kValueTokenOf = makeValueTokenOf();
+constexpr std::array<uint8_t, 256> kKeyTokenOf = makeKeyTokenOf();
+
+// Re-weighting value tokens: the 32 values of a byte's upper 5 bits ("slots")
+// are shared out in proportion to per-token weights (largest remainder, ties
+// to the lower token), and each token's slots are handed out round-robin in
+// token order. Equal weights reproduce kValueTokenOf exactly; a zero weight
+// drops a token. Size bits are untouched, so containers keep 0..7 children.
+using ValueMap = std::array<uint8_t, 256>;
+using Weights = std::array<uint32_t, kNumGeneralTokens>;
+
+constexpr size_t kNumValueSlots = 32;
+
+constexpr ValueMap makeWeightedValueTokenOf(const Weights &weights) {
+    uint64_t total = 0;
+    for (uint32_t w : weights)
+        total += w;
+    if (total == 0)
+        return kValueTokenOf;
+
+    std::array<size_t, kNumGeneralTokens> slots{};
+    std::array<uint64_t, kNumGeneralTokens> remainder{};
+    size_t given = 0;
+    for (size_t t = 0; t < kNumGeneralTokens; ++t) {
+        uint64_t quota = kNumValueSlots * static_cast<uint64_t>(weights[t]);
+        slots[t] = static_cast<size_t>(quota / total);
+        remainder[t] = quota % total;
+        given += slots[t];
+    }
+    for (; given < kNumValueSlots; ++given) {
+        size_t best = 0;
+        for (size_t t = 1; t < kNumGeneralTokens; ++t) {
+            if (remainder[t] > remainder[best])
+                best = t;
+        }
+        ++slots[best];
+        remainder[best] = 0;
+    }
+
+    ValueMap map{};
+    size_t slot = 0;
+    for (size_t round = 0; slot < kNumValueSlots; ++round) {
+        for (size_t t = 0; t < kNumGeneralTokens && slot < kNumValueSlots; ++t) {
+            if (slots[t] > round) {
+                for (size_t sizeBits = 0; sizeBits < 8; ++sizeBits)
+                    map[slot << 3 | sizeBits] = static_cast<uint8_t>(t);
+                ++slot;
+            }
+        }
+    }
+    return map;
+}
+
+constexpr Weights equalWeights() {
+    Weights w{};
+    for (uint32_t &x : w)
+        x = 1;
+    return w;
+}
+
+constexpr bool sameMap(const ValueMap &a, const ValueMap &b) {
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i] != b[i])
+            return false;
+    }
+    return true;
+}
+
+static_assert(sameMap(makeWeightedValueTokenOf(equalWeights()), kValueTokenOf),
+              "equal weights must give the default token map");
+
+// Token groups accepted by parseWeights, as [first, last) ranges of
+// kGeneralTokens.
+struct WeightGroup {
+    const char *name;
+    uint8_t first;
+    uint8_t last;
+};
+
+constexpr WeightGroup kWeightGroups[] = {
+    {"false", 0, 1},   {"true", 1, 2},    {"null", 2, 3},
+    {"string", 3, 17}, {"number", 17, 23},
+    {"array", 23, 24}, {"object", 24, 25},
+};
+
+// A weight: decimal digits only, so "-1" and "" are rejected rather than
+// read as ULONG_MAX or 0.
+inline bool parseWeight(const char *text, uint32_t &weight) {
+    if (*text < '0' || *text > '9')
+        return false;
+    char *rest;
+    unsigned long w = std::strtoul(text, &rest, 10);
+    if (*rest || w > UINT32_MAX)
+        return false;
+    weight = static_cast<uint32_t>(w);
+    return true;
+}
+
+// Parses a weight spec: comma separated items, each either a bare weight
+// (applied to the next token in kGeneralTokens order) or NAME=WEIGHT for a
+// token index or one of kWeightGroups, e.g. "array=8,object=8,string=1".
+// Tokens not mentioned keep their weight in `weights`. False on a bad item
+// (a negative or missing weight among them) and on a spec with no items.
+inline bool parseWeights(const char *spec, Weights &weights) {
+    size_t next = 0;
+    size_t items = 0;
+    while (*spec) {
+        const char *end = std::strchr(spec, ',');
+        if (!end)
+            end = spec + std::strlen(spec);
+        std::string item(spec, end);
+        spec = *end ? end + 1 : end;
+        if (item.empty())
+            continue;
+        ++items;
+
+        size_t eq = item.find('=');
+        uint32_t w;
+        if (!parseWeight(item.c_str() + (eq == std::string::npos ? 0 : eq + 1), w))
+            return false;
+        if (eq == std::string::npos) {
+            if (next >= kNumGeneralTokens)
+                return false;
+            weights[next++] = w;
+            continue;
+        }
+        std::string name = item.substr(0, eq);
+        bool found = false;
+        for (const WeightGroup &g : kWeightGroups) {
+            if (name == g.name) {
+                for (size_t t = g.first; t < g.last; ++t)
+                    weights[t] = w;
+                found = true;
+            }
+        }
+        if (!found) {
+            uint32_t t;
+            if (!parseWeight(name.c_str(), t) || t >= kNumGeneralTokens)
+                return false;
+            weights[t] = w;
+        }
+    }
+    return items > 0;
+}
+
+template <size_t N>
+constexpr size_t maxLength(const std::array<Token, N> &tokens) {
+    size_t longest = 0;
+    for (const Token &t : tokens)
+        longest = t.length > longest ? t.length : longest;
+    return longest;
+}
+
+// Longest single token: the key/string literal "\u0000" (8 bytes).
+constexpr size_t kMaxTokenLength = maxLength(kGeneralTokens) > maxLength(kStringTokens)
+                                       ? maxLength(kGeneralTokens)
+                                       : maxLength(kStringTokens);
+
+} // namespace json_tokens
+
+// Encoder input layouts: the Format policy of BasicJsonEncoder.
+namespace json_format {
+
+// The original layout. A value is one byte: its upper 5 bits pick the token
+// through the value map, its lower 3 bits a container's child count. A key
+// is one byte. Reads past the end return 0, so a short input pads out with
+// false values and "a" keys.
+struct Bytes {
+    static constexpr bool kCompact = false;
+};
+
+// Compact v1. A value is a LEB128 varint v: token v % 25, and for
+// containers child count (v / 25) % 8, so every scalar and containers of
+// up to four children take one byte. A key is a varint k: string token
+// k % 14. Decoding is length-aware: at the end of the input open containers
+// close and a missing value is null, so no bytes go to padding. The value
+// map is not used; weights do not apply. A v1 testcase is a Header and
+// then documents back to back.
+struct Compact {
+    static constexpr bool kCompact = true;
+};
+
+constexpr uint8_t kCompactVersion = 1;
+
+// Testcase header: the version byte, then varints for the option mask
+// (CharReaderBuilder bits, as harness::optionMask), the depth limit and the
+// node budget. A zero limit means the harness default.
+struct Header {
+    uint32_t mask;
+    uint32_t maxDepth;
+    uint32_t maxNodes;
+};
+
+// Reads a varint of at most 5 bytes at data[pos]; false if the input ends
+// inside it (value then holds the bytes read).
+inline bool readVarint(const uint8_t *data, size_t size, size_t &pos, uint32_t &value) {
+    value = 0;
+    for (unsigned i = 0; i < 5; ++i) {
+        if (pos >= size)
+            return false;
+        uint8_t b = data[pos++];
+        value |= static_cast<uint32_t>(b & 0x7f) << (7 * i);
+        if (!(b & 0x80))
+            return true;
+    }
+    return true;  // a continuation bit on the fifth byte is ignored
+}
+
+inline void appendVarint(std::string &out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+// Bytes taken by a v1 header at the start of data, or 0 if there is none.
+inline size_t readHeader(const uint8_t *data, size_t size, Header &header) {
+    size_t pos = 0;
+    if (size == 0 || data[pos++] != kCompactVersion)
+        return 0;
+    if (!readVarint(data, size, pos, header.mask) ||
+        !readVarint(data, size, pos, header.maxDepth) ||
+        !readVarint(data, size, pos, header.maxNodes))
+        return 0;
+    return pos;
+}
+
+inline void appendHeader(std::string &out, const Header &header) {
+    out.push_back(static_cast<char>(kCompactVersion));
+    appendVarint(out, header.mask);
+    appendVarint(out, header.maxDepth);
+    appendVarint(out, header.maxNodes);
+}
+
+// Compact codes for a value token (and child count) and a key token.
+inline uint32_t compactValue(size_t token, uint8_t count) {
+    return static_cast<uint32_t>(token + json_tokens::kNumGeneralTokens * count);
+}
+
+inline uint32_t compactKey(size_t token) {
+    return static_cast<uint32_t>(token);
+}
+
+} // namespace json_format
+
+template <class Format>
+class BasicJsonEncoder {
+public:
+    // Default limits. The recursive encoder was capped at depth 8 to bound its
+    // call stack; encodeIterativeInto() keeps an explicit stack instead and
+    // accepts any maxDepth up to kMaxStackDepth.
+    static constexpr size_t kMaxDepth = 8;
+    static constexpr size_t kMaxNodes = 1024;
+    // Above OurReader's default stackLimit (1000), so its limit can be hit.
+    static constexpr size_t kMaxStackDepth = 4096;
+
+    static constexpr size_t kMaxTokenLength = json_tokens::kMaxTokenLength;
+    // sizeBits is 3 bits, so a container has at most 7 children.
+    static constexpr size_t kMaxFanout = 7;
+    // Worst case for one emitted value, including what precedes it inside a
+    // container: ',' + key + ':' + token. Containers themselves add 2 bytes.
+    static constexpr size_t kMaxItemBytes = 1 + kMaxTokenLength + 1 + kMaxTokenLength;
+
+    // Upper bound on encode() output for a node budget. Every value is either
+    // counted against the budget or a "null" child of a counted container
+    // that hit a limit, so there are at most 1 + kMaxFanout * maxNodes values.
+    static constexpr size_t outputBound(size_t maxNodes) {
+        return (1 + kMaxFanout * maxNodes) * kMaxItemBytes;
+    }
+
+    BasicJsonEncoder(const uint8_t *data, size_t size,
+                     size_t maxDepth = kMaxDepth, size_t maxNodes = kMaxNodes)
+        : data_(data), size_(size), pos_(0), depth_(0), nodeCount_(0),
+          maxDepth_(maxDepth < kMaxStackDepth ? maxDepth : kMaxStackDepth),
+          maxNodes_(maxNodes) {}
+
+    // Encode into buf, which must hold outputBound(maxNodes) bytes. Nothing
+    // is allocated; the returned view points into buf.
+    std::string_view encodeInto(char *buf) {
+        out_ = buf;
+        len_ = 0;
+        depth_ = 0;
+        nodeCount_ = 0;
+        emitValue();              // emit exactly one JSON value
+        return std::string_view(out_, len_);
+    }
+
+    // Byte-identical to encodeInto() for the same input and limits, but walks
+    // containers with a fixed explicit stack instead of recursing through
+    // emitValue/emitArray/emitObject, so deep documents cost no extra call
+    // frames per level.
+    std::string_view encodeIterativeInto(char *buf) {
+        out_ = buf;
+        len_ = 0;
+        Writer writer{*this};
+        walk(writer);
+        return std::string_view(out_, len_);
+    }
+
+    // One value as laid out in the encoder input. Values are read in
+    // pre-order, so a value and its whole subtree decode from the contiguous
+    // bytes [begin, end), and an object member also owns the key byte at
+    // keyPos just before it. Values forced to null by the depth/node limits
+    // (or by the end of compact input) read no bytes and get no Node; values
+    // read past the end of byte-layout input (zero padding) have
+    // begin == end.
+    struct Node {
+        static constexpr uint32_t kNone = UINT32_MAX;
+
+        uint32_t begin;
+        uint32_t end;
+        uint32_t keyPos;          // key byte of an object member, or kNone
+        uint32_t parent;          // index of the enclosing container, or kNone
+        uint8_t count;            // sizeBits of an array/object
+        json_tokens::Kind kind;
+    };
+
+    // Decodes the input exactly like encodeIterativeInto() but records the
+    // layout of every value instead of emitting JSON. Nodes are appended in
+    // pre-order; consumed() afterwards is where the document ended.
+    void describe(std::vector<Node> &nodes) {
+        Recorder recorder{nodes, {}, Node::kNone};
+        walk(recorder);
+    }
+
+    // Values decoded and the deepest level reached (the root is level 1),
+    // walking the input like describe() without recording anything.
+    struct Extent {
+        size_t nodes = 0;
+        size_t maxDepth = 0;
+    };
+
+    Extent extent() {
+        Measurer measurer;
+        walk(measurer);
+        return measurer.extent;
+    }
+
+    // Appends the input re-encoded in the compact v1 layout (no header):
+    // CompactEncoder under the same limits decodes it to the same JSON,
+    // padding included. consumed() afterwards is where the document ended.
+    void toCompact(std::string &out) {
+        CompactWriter writer{out};
+        walk(writer);
+    }
+
+    // Input bytes read so far; reads past the end (padding) are not counted.
+    size_t consumed() const {
+        return pos_;
+    }
+
+    // Value byte -> kGeneralTokens index used by every byte-layout encoder in
+    // the process (default json_tokens::kValueTokenOf). Set it before
+    // encoding starts and keep `map` alive; queue entries only replay under
+    // the same table.
+    static void setValueMap(const json_tokens::ValueMap &map) {
+        valueMap_ = &map;
+    }
+
+    static const json_tokens::ValueMap &valueMap() {
+        return *valueMap_;
+    }
+
+    // Values read from the input by the last encode/describe; nulls forced
+    // by the depth/node limits are not counted.
+    size_t nodeCount() const {
+        return nodeCount_;
+    }
+
+    // Convenience copy for callers that want a std::string, for any node
+    // budget: the buffer is sized by outputBound(maxNodes) on the heap.
+    std::string encode() {
+        std::string out(outputBound(maxNodes_), '\0');
+        out.resize(encodeInto(out.data()).size());
+        return out;
+    }
+
+private:
+    static inline const json_tokens::ValueMap *valueMap_ = &json_tokens::kValueTokenOf;
+
+    struct Frame {
+        uint8_t remaining;        // children still to emit
+        bool object;
+        bool first;
+    };
+
+    const uint8_t *data_;
+    size_t size_;
+    size_t pos_;
+    size_t depth_;
+    size_t nodeCount_;
+    size_t maxDepth_;
+    size_t maxNodes_;
+    char *out_ = nullptr;
+    size_t len_ = 0;
+    Frame stack_[kMaxStackDepth];
+
+    template <size_t N>
+    void put(const char (&token)[N]) {
+        std::memcpy(out_ + len_, token, N - 1);
+        len_ += N - 1;
+    }
+
+    void put(char c) {
+        out_[len_++] = c;
+    }
+
+    uint8_t nextByte() {
+        if (pos_ >= size_) {
+            return 0; // default when out of data
+        }
+        return data_[pos_++];
+    }
+
+    // One value's token; count gets a container's child count.
+    const json_tokens::Token &readValue(uint8_t &count) {
+        if constexpr (Format::kCompact) {
+            uint32_t v;
+            json_format::readVarint(data_, size_, pos_, v);
+            count = static_cast<uint8_t>((v / json_tokens::kNumGeneralTokens) % (kMaxFanout + 1));
+            return json_tokens::kGeneralTokens[v % json_tokens::kNumGeneralTokens];
+        } else {
+            uint8_t b = nextByte();
+            count = b & 0x07;
+            return json_tokens::kGeneralTokens[(*valueMap_)[b]];
+        }
+    }
+
+    const json_tokens::Token &readKey() {
+        if constexpr (Format::kCompact) {
+            uint32_t k;
+            json_format::readVarint(data_, size_, pos_, k);
+            return json_tokens::kStringTokens[k % json_tokens::kNumStringTokens];
+        } else {
+            return json_tokens::kStringTokens[json_tokens::kKeyTokenOf[nextByte()]];
+        }
+    }
+
+    // Compact input ends the structure with the data: nothing more to read.
+    bool exhausted() const {
+        return Format::kCompact && pos_ >= size_;
+    }
+
+    void put(const json_tokens::Token &token) {
+        std::memcpy(out_ + len_, token.text, token.length);
+        len_ += token.length;
+    }
+
+    // The explicit-stack decoder behind encodeIterativeInto() and describe().
+    // Every byte is read here, so both see the same structure; the visitor
+    // only decides what to do with it.
+    template <class Visitor>
+    void walk(Visitor &visitor) {
+        nodeCount_ = 0;
+        size_t top = 0;           // open containers, i.e. the current depth
+        bool wantValue = true;    // the root value
+        for (;;) {
+            if (wantValue) {
+                wantValue = false;
+                if (top >= maxDepth_ || nodeCount_ >= maxNodes_ || exhausted()) {
+                    visitor.limitNull();
+                } else {
+                    ++nodeCount_;
+                    size_t at = pos_;
+                    uint8_t count;
+                    const json_tokens::Token &token = readValue(count);
+                    if (token.kind == json_tokens::Kind::Scalar) {
+                        visitor.scalar(token, at, pos_);
+                    } else {
+                        bool object = token.kind == json_tokens::Kind::Object;
+                        visitor.open(token.kind, at, count);
+                        stack_[top++] = Frame{count, object, true};
+                    }
+                }
+            }
+            if (top == 0)
+                break;
+
+            Frame &frame = stack_[top - 1];
+            // Compact input ends a container where it runs out, except over
+            // an array's limit nulls: those read nothing, so toCompact()
+            // writes nothing for them and they must still be emitted here.
+            // (An object member still has its key, so input remains.)
+            const bool limitChild = !frame.object && (top >= maxDepth_ || nodeCount_ >= maxNodes_);
+            if (frame.remaining == 0 || (exhausted() && !limitChild)) {
+                visitor.close(frame.object, pos_);
+                --top;
+                continue;
+            }
+            visitor.separator(frame.first);
+            frame.first = false;
+            --frame.remaining;
+            if (frame.object) {   // key must be a string
+                size_t at = pos_;
+                visitor.key(readKey(), at);
+            }
+            wantValue = true;
+        }
+    }
+
+    struct Writer {
+        BasicJsonEncoder &enc;
+
+        void limitNull() { enc.put("null"); }
+        void scalar(const json_tokens::Token &token, size_t, size_t) { enc.put(token); }
+        void open(json_tokens::Kind kind, size_t, uint8_t) {
+            enc.put(kind == json_tokens::Kind::Object ? '{' : '[');
+        }
+        void close(bool object, size_t) { enc.put(object ? '}' : ']'); }
+        void separator(bool first) {
+            if (!first) enc.put(',');
+        }
+        void key(const json_tokens::Token &token, size_t) {
+            enc.put(token);
+            enc.put(':');
+        }
+    };
+
+    struct CompactWriter {
+        std::string &out;
+
+        // Limit nulls read nothing, and the compact decoder hits the same
+        // limits at the same places.
+        void limitNull() {}
+        void scalar(const json_tokens::Token &token, size_t, size_t) {
+            json_format::appendVarint(out, json_format::compactValue(&token - json_tokens::kGeneralTokens.data(), 0));
+        }
+        void open(json_tokens::Kind kind, size_t, uint8_t count) {
+            json_format::appendVarint(out, json_format::compactValue(json_tokens::tokenOfKind(kind), count));
+        }
+        void close(bool, size_t) {}
+        void separator(bool) {}
+        void key(const json_tokens::Token &token, size_t) {
+            json_format::appendVarint(out, json_format::compactKey(&token - json_tokens::kStringTokens.data()));
+        }
+    };
+
+    struct Recorder {
+        std::vector<Node> &nodes;
+        std::vector<uint32_t> openNodes;  // indices of the open containers
+        uint32_t keyPos;
+
+        void add(json_tokens::Kind kind, size_t begin, size_t end, uint8_t count) {
+            uint32_t parent = openNodes.empty() ? Node::kNone : openNodes.back();
+            nodes.push_back(Node{static_cast<uint32_t>(begin), static_cast<uint32_t>(end),
+                                 keyPos, parent, count, kind});
+            keyPos = Node::kNone;
+        }
+        void limitNull() { keyPos = Node::kNone; }
+        void scalar(const json_tokens::Token &, size_t begin, size_t end) {
+            add(json_tokens::Kind::Scalar, begin, end, 0);
+        }
+        void open(json_tokens::Kind kind, size_t begin, uint8_t count) {
+            add(kind, begin, begin, count);
+            openNodes.push_back(static_cast<uint32_t>(nodes.size() - 1));
+        }
+        void close(bool, size_t end) {
+            nodes[openNodes.back()].end = static_cast<uint32_t>(end);
+            openNodes.pop_back();
+        }
+        void separator(bool) {}
+        void key(const json_tokens::Token &, size_t at) { keyPos = static_cast<uint32_t>(at); }
+    };
+
+    struct Measurer {
+        Extent extent;
+        size_t depth = 0;
+
+        void value() {
+            ++extent.nodes;
+            if (depth + 1 > extent.maxDepth)
+                extent.maxDepth = depth + 1;
+        }
+        void limitNull() {}
+        void scalar(const json_tokens::Token &, size_t, size_t) { value(); }
+        void open(json_tokens::Kind, size_t, uint8_t) {
+            value();
+            ++depth;
+        }
+        void close(bool, size_t) { --depth; }
+        void separator(bool) {}
+        void key(const json_tokens::Token &, size_t) {}
+    };
+
+    void emitValue() {
+        if (depth_ >= maxDepth_ || nodeCount_ >= maxNodes_ || exhausted()) {
+            put("null");
+            return;
+        }
+        ++nodeCount_;
+
+        // byte layout: upper 5 bits → token, lower 3 bits → size (0..7) for
+        // arrays/objects
+        uint8_t sizeBits;
+        const json_tokens::Token &token = readValue(sizeBits);
+
+        switch (token.kind) {
+            case json_tokens::Kind::Scalar:
+                put(token);
+                break;
+            case json_tokens::Kind::Array:
+                emitArray(sizeBits);   // 0..7 elements
+                break;
+            case json_tokens::Kind::Object:
+                emitObject(sizeBits);  // 0..7 fields
+                break;
+        }
+    }
+
+    void emitArray(unsigned count) {
+        if (depth_ >= maxDepth_) {
+            put("null");
+            return;
+        }
+        put('[');
+        ++depth_;
+        // Limit nulls are emitted past the end of compact input, as in walk()
+        for (unsigned i = 0; i < count && (!exhausted() || depth_ >= maxDepth_ || nodeCount_ >= maxNodes_); ++i) {
+            if (i > 0) put(',');
+            emitValue();
+        }
+        --depth_;
+        put(']');
+    }
+
+    void emitObject(unsigned count) {
+        if (depth_ >= maxDepth_) {
+            put("null");
+            return;
+        }
+        put('{');
+        ++depth_;
+        for (unsigned i = 0; i < count && !exhausted(); ++i) {
+            if (i > 0) put(',');
+            emitKey();              // key must be a string
+            put(':');
+            emitValue();            // value: any general token
+        }
+        --depth_;
+        put('}');
+    }
+
+    void emitKey() {
+        put(readKey());
+    }
+};
+
+using JsonEncoder = BasicJsonEncoder<json_format::Bytes>;
+using CompactEncoder = BasicJsonEncoder<json_format::Compact>;
+
+// Limits used by the encoder harnesses. Raise ENCODER_MAX_DEPTH (and the
+// node budget with it) to push documents into OurReader's stackLimit path.
+#ifndef ENCODER_MAX_DEPTH
+#define ENCODER_MAX_DEPTH JsonEncoder::kMaxDepth
+#endif
+#ifndef ENCODER_MAX_NODES
+#define ENCODER_MAX_NODES JsonEncoder::kMaxNodes
+#endif
@@ -0,0 +1,283 @@
+// AFL++ custom mutator built on JsonEncoder.
+//
+// Queue entries are encoder input: two option bytes A,B followed by encoder
+// bytes, decoded back-to-back as in HARNESS_FRAMING_STREAM. afl_custom_fuzz
+// mutates them at the token level using the encoder's own node layout
+// (JsonEncoder::describe), and afl_custom_post_process turns the result into
+// what main.cpp reads: A,B then one JSON document per line. Encoding runs in
+// the fuzzer process, so the target is the plain main.cpp parse loop.
+//
+// Build:
+//   clang++ -O2 -std=c++17 -shared -fPIC json_mutator.cpp -o json_mutator.so
+// Use:
+//   AFL_CUSTOM_MUTATOR_LIBRARY=./json_mutator.so afl-fuzz ... -- ./jsoncpp_fuzz
+// ENCODER_TOKEN_WEIGHTS (token_weights.h) re-weights token choice here too;
+// the mutator writes tokens through whatever table is installed.
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "json_encoder.h"
+#include "token_weights.h"
+
+namespace {
+
+constexpr size_t kHeaderSize = 2;   // option bytes A,B
+
+struct Mutator {
+    uint64_t rng;
+    // upper-5-bit slots decoding to each value token under the installed map
+    std::array<std::vector<uint8_t>, json_tokens::kNumGeneralTokens> slotsOf;
+    std::vector<uint8_t> fuzzBuf;
+    std::string postBuf;
+    std::vector<JsonEncoder::Node> nodes;
+    std::vector<JsonEncoder::Node> donorNodes;
+    const char *lastOp = "jsontok";
+
+    uint64_t next() {
+        // xorshift64*
+        rng ^= rng >> 12;
+        rng ^= rng << 25;
+        rng ^= rng >> 27;
+        return rng * 0x2545F4914F6CDD1DULL;
+    }
+
+    size_t below(size_t n) {
+        return n ? next() % n : 0;
+    }
+
+    void indexSlots() {
+        const json_tokens::ValueMap &map = JsonEncoder::valueMap();
+        for (size_t slot = 0; slot < json_tokens::kNumValueSlots; ++slot)
+            slotsOf[map[slot << 3]].push_back(static_cast<uint8_t>(slot));
+    }
+
+    // Encoder byte for a value token with the given size bits, or false if
+    // the token has no slot (weight 0).
+    bool valueByte(size_t token, unsigned sizeBits, uint8_t &out) {
+        const std::vector<uint8_t> &slots = slotsOf[token];
+        if (slots.empty())
+            return false;
+        out = static_cast<uint8_t>((slots[below(slots.size())] << 3) | (sizeBits & 0x07));
+        return true;
+    }
+};
+
+// All documents of an encoder stream, with node positions made absolute
+// (offset by base) so they index straight into the testcase.
+void describeStream(const uint8_t *data, size_t size, size_t base,
+                    std::vector<JsonEncoder::Node> &nodes) {
+    nodes.clear();
+    size_t pos = 0;
+    while (pos < size) {
+        size_t first = nodes.size();
+        JsonEncoder enc(data + pos, size - pos, ENCODER_MAX_DEPTH, ENCODER_MAX_NODES);
+        enc.describe(nodes);
+        for (size_t i = first; i < nodes.size(); ++i) {
+            JsonEncoder::Node &n = nodes[i];
+            n.begin += pos + base;
+            n.end += pos + base;
+            if (n.keyPos != JsonEncoder::Node::kNone)
+                n.keyPos += pos + base;
+            if (n.parent != JsonEncoder::Node::kNone)
+                n.parent += first;
+        }
+        if (enc.consumed() == 0)
+            break;
+        pos += enc.consumed();
+    }
+}
+
+// Nodes backed by real input bytes (not zero padding past the end).
+bool hasBytes(const JsonEncoder::Node &n) {
+    return n.begin < n.end;
+}
+
+// The bytes a container member occupies: its key byte (object members)
+// and its subtree.
+size_t memberBegin(const JsonEncoder::Node &n) {
+    return n.keyPos != JsonEncoder::Node::kNone ? n.keyPos : n.begin;
+}
+
+void replaceRange(std::vector<uint8_t> &buf, size_t begin, size_t end,
+                  const uint8_t *with, size_t withSize) {
+    buf.erase(buf.begin() + begin, buf.begin() + end);
+    buf.insert(buf.begin() + begin, with, with + withSize);
+}
+
+// One token-level mutation of m.fuzzBuf. Returns false if the picked
+// operation had nothing to work on.
+bool mutateOnce(Mutator &m, const uint8_t *donor, size_t donorSize) {
+    std::vector<uint8_t> &buf = m.fuzzBuf;
+    describeStream(buf.data() + kHeaderSize, buf.size() - kHeaderSize, kHeaderSize, m.nodes);
+
+    std::vector<JsonEncoder::Node> &nodes = m.nodes;
+    size_t op = m.below(8);
+    if (op == 7 || nodes.empty()) {
+        // option bytes: flip one of the 11 reader option bits
+        unsigned bit = static_cast<unsigned>(m.below(11));
+        buf[bit / 8] ^= static_cast<uint8_t>(1u << (bit % 8));
+        m.lastOp = "jsonopt";
+        return true;
+    }
+
+    const JsonEncoder::Node target = nodes[m.below(nodes.size())];
+    switch (op) {
+        case 0: {
+            // splice: replace a subtree with one from the other queue entry
+            if (!hasBytes(target) || donorSize <= kHeaderSize)
+                return false;
+            describeStream(donor + kHeaderSize, donorSize - kHeaderSize, kHeaderSize, m.donorNodes);
+            if (m.donorNodes.empty())
+                return false;
+            const JsonEncoder::Node &src = m.donorNodes[m.below(m.donorNodes.size())];
+            if (!hasBytes(src))
+                return false;
+            replaceRange(buf, target.begin, target.end, donor + src.begin, src.end - src.begin);
+            m.lastOp = "jsonsplice";
+            return true;
+        }
+        case 1: {
+            // replace a subtree with a random scalar
+            if (!hasBytes(target))
+                return false;
+            size_t token;
+            do {
+                token = m.below(json_tokens::kNumGeneralTokens);
+            } while (json_tokens::kGeneralTokens[token].kind != json_tokens::Kind::Scalar);
+            uint8_t b;
+            if (!m.valueByte(token, static_cast<unsigned>(m.below(8)), b))
+                return false;
+            replaceRange(buf, target.begin, target.end, &b, 1);
+            m.lastOp = "jsonscalar";
+            return true;
+        }
+        case 2: {
+            // replace a subtree with null
+            uint8_t null;
+            if (!hasBytes(target) || !m.valueByte(2, 0, null))
+                return false;
+            replaceRange(buf, target.begin, target.end, &null, 1);
+            m.lastOp = "jsonnull";
+            return true;
+        }
+        case 3: {
+            // duplicate a member inside its container
+            if (target.parent == JsonEncoder::Node::kNone || !hasBytes(target))
+                return false;
+            const JsonEncoder::Node &parent = nodes[target.parent];
+            if (parent.count >= JsonEncoder::kMaxFanout || !hasBytes(parent))
+                return false;
+            std::vector<uint8_t> copy(buf.begin() + memberBegin(target), buf.begin() + target.end);
+            buf.insert(buf.begin() + target.end, copy.begin(), copy.end());
+            buf[parent.begin] = static_cast<uint8_t>(buf[parent.begin] + 1);
+            m.lastOp = "jsondup";
+            return true;
+        }
+        case 4: {
+            // drop a member from its container
+            if (target.parent == JsonEncoder::Node::kNone)
+                return false;
+            const JsonEncoder::Node &parent = nodes[target.parent];
+            if (parent.count == 0 || !hasBytes(parent))
+                return false;
+            buf.erase(buf.begin() + memberBegin(target), buf.begin() + target.end);
+            buf[parent.begin] = static_cast<uint8_t>(buf[parent.begin] - 1);
+            m.lastOp = "jsondrop";
+            return true;
+        }
+        case 5: {
+            // change an object key
+            if (target.keyPos == JsonEncoder::Node::kNone || target.keyPos >= buf.size())
+                return false;
+            buf[target.keyPos] = static_cast<uint8_t>(m.below(json_tokens::kNumStringTokens));
+            m.lastOp = "jsonkey";
+            return true;
+        }
+        case 6: {
+            // wrap a subtree in a one-element array or object
+            if (!hasBytes(target) || target.end - target.begin >= 4096)
+                return false;
+            bool object = m.next() & 1;
+            // array is token 23, object 24 (see json_tokens::kGeneralTokens)
+            uint8_t wrapper[2] = {0, static_cast<uint8_t>(m.below(json_tokens::kNumStringTokens))};
+            if (!m.valueByte(object ? 24 : 23, 1, wrapper[0]))
+                return false;
+            buf.insert(buf.begin() + target.begin, wrapper, wrapper + (object ? 2 : 1));
+            m.lastOp = "jsonwrap";
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+extern "C" {
+
+void *afl_custom_init(void *afl, unsigned int seed) {
+    (void)afl;
+    Mutator *m = new Mutator();
+    m->rng = (static_cast<uint64_t>(seed) << 1) | 1;
+    harness::loadTokenWeights();
+    m->indexSlots();
+    return m;
+}
+
+size_t afl_custom_fuzz(void *data, uint8_t *buf, size_t buf_size, uint8_t **out_buf,
+                       uint8_t *add_buf, size_t add_buf_size, size_t max_size) {
+    Mutator &m = *static_cast<Mutator *>(data);
+    m.fuzzBuf.assign(buf, buf + buf_size);
+    while (m.fuzzBuf.size() < kHeaderSize + 1)
+        m.fuzzBuf.push_back(0);
+
+    // stack a few token-level mutations, like havoc does
+    size_t rounds = 1 + m.below(4);
+    for (size_t i = 0, tries = 0; i < rounds && tries < 16; ++tries) {
+        if (mutateOnce(m, add_buf, add_buf ? add_buf_size : 0))
+            ++i;
+    }
+
+    if (m.fuzzBuf.size() > max_size)
+        m.fuzzBuf.resize(max_size);
+    *out_buf = m.fuzzBuf.data();
+    return m.fuzzBuf.size();
+}
+
+size_t afl_custom_post_process(void *data, uint8_t *buf, size_t buf_size, uint8_t **out_buf) {
+    Mutator &m = *static_cast<Mutator *>(data);
+    static char arena[JsonEncoder::outputBound(ENCODER_MAX_NODES)];
+
+    m.postBuf.clear();
+    if (buf_size < kHeaderSize) {
+        *out_buf = buf;
+        return buf_size;
+    }
+    m.postBuf.append(reinterpret_cast<const char *>(buf), kHeaderSize);
+
+    size_t pos = kHeaderSize;
+    while (pos < buf_size) {
+        JsonEncoder enc(buf + pos, buf_size - pos, ENCODER_MAX_DEPTH, ENCODER_MAX_NODES);
+        std::string_view json = enc.encodeIterativeInto(arena);
+        m.postBuf.append(json.data(), json.size());
+        m.postBuf.push_back('\n');
+        if (enc.consumed() == 0)
+            break;
+        pos += enc.consumed();
+    }
+
+    *out_buf = reinterpret_cast<uint8_t *>(&m.postBuf[0]);
+    return m.postBuf.size();
+}
+
+const char *afl_custom_describe(void *data, size_t max_description_len) {
+    (void)max_description_len;
+    return static_cast<Mutator *>(data)->lastOp;
+}
+
+void afl_custom_deinit(void *data) {
+    delete static_cast<Mutator *>(data);
+}
+
+} // extern "C"
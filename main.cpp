@@ -1,50 +1,95 @@
-#include <iostream>
 #include <string>
 #include <memory>
+#include <cstdint>
+#include <exception>
 #include <jsoncpp/json/json.h>
-int main() {
-    // Set up the modern JsonCpp parser
-    Json::CharReaderBuilder builder;
-    char A,B;
-    std::cin.get(A);
-    std::cin.get(B);
-builder["collectComments"] = A & 0x1;
-builder["allowComments"] = A & 0x2;
-builder["allowTrailingCommas"] = A & 0x4;
-builder["strictRoot"] = A & 0x8;
-builder["allowDroppedNullPlaceholders"] = A & 0x10;
-builder["allowNumericKeys"] = A & 0x20;
-builder["allowSingleQuotes"] = A & 0x40;
-builder["failIfExtra"] = A & 0x80;
-builder["rejectDupKeys"] = B & 0x1;
-builder["allowSpecialFloats"] = B & 0x2;
-builder["skipBom"] = B & 0x4;
-    std::string line;
-
-    while (std::getline(std::cin, line)) {
-        // Skip empty lines (optional)
-        if (line.empty())
-            continue;
+#define HARNESS_BATCH
+#define HARNESS_SHAPE
+#include "harness.h"
 
-        Json::Value root;
+// One testcase: two option bytes A,B followed by newline separated JSON
+// documents. Same layout as the old std::cin.get / std::getline loop.
+static void runTestcase(const uint8_t *data, size_t size) {
+    if (size < 2)
+        return;
+    const unsigned mask = harness::optionMask(data[0], data[1]);
+    harness::maskStats().testcase(mask);
+
+    // Copied into a reused string rather than parsed in place: OurReader peeks
+    // one byte past the end after a '\r' when locating errors, and the old
+    // std::getline loop always had a NUL there.
+    static std::string line;
+
+    const char *text = reinterpret_cast<const char *>(data);
+    harness::forEachLine(text + 2, text + size, [&](const char *p, const char *lineEnd) {
+        harness::ParseRoot parsed;      // recycled with -DHARNESS_VALUE_ARENA
+        Json::Value &root = parsed.get();
         std::string errs;
+        // Formatting error messages is only worth it when they get printed
+        // or counted
+        std::string *errsOut = harness::kEcho || harness::maskStats().enabled() ? &errs : nullptr;
 
-        std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
-        
-        bool ok = reader->parse(
-            line.c_str(),
-            line.c_str() + line.size(),
-            &root,
-            &errs
-        );
+        // Built once per option mask and reused (see ReaderCache)
+        Json::CharReader &reader = harness::readerCache().get(mask);
+
+        line.assign(p, lineEnd);
+        bool ok;
+        {
+            harness::StageTimer timer(harness::Stage::Parse, line.size());
+            ok = reader.parse(
+                line.c_str(),
+                line.c_str() + line.size(),
+                &root,
+                errsOut
+            );
+        }
+        harness::maskStats().document(mask, ok, errs);
 
         if (ok) {
-            // For fuzzing you might comment this out to keep output minimal
-            std::cout << "OK\n";
+            harness::roundTrip(root);   // -DHARNESS_ROUNDTRIP
+            // Compiled out in fuzzing builds (see HARNESS_ECHO)
+            harness::echo("OK\n");
         } else {
-            std::cout << "ERR: " << errs << "\n";
+            harness::echo("ERR: ");
+            harness::echo(errs);
+            harness::echo("\n");
+        }
+    });
+}
+
+// runTestcase for --batch: every error message is kept and hashed, nothing
+// is echoed, and all state is the worker's own.
+static harness::Outcome evaluateTestcase(const uint8_t *data, size_t size, harness::ReaderCache &readers) {
+    harness::Outcome outcome;
+    if (size < 2)
+        return outcome;
+    Json::CharReader &reader = readers.get(harness::optionMask(data[0], data[1]));
+    thread_local std::string line;
+
+    const char *text = reinterpret_cast<const char *>(data);
+    harness::forEachLine(text + 2, text + size, [&](const char *p, const char *lineEnd) {
+        Json::Value root;
+        std::string errs;
+        line.assign(p, lineEnd);
+        bool ok;
+        try {
+            ok = reader.parse(line.c_str(), line.c_str() + line.size(), &root, &errs);
+        } catch (const std::exception &e) {
+            outcome.threw(e.what());
+            return;
         }
-    }
+        outcome.document(ok, errs);
+    });
+    return outcome;
+}
 
-    return 0;
-}
\ No newline at end of file
+// For --profile-replay: the mask and the number of documents.
+static harness::Shape testcaseShape(const uint8_t *data, size_t size) {
+    harness::Shape shape;
+    if (size < 2)
+        return shape;
+    shape.mask = harness::optionMask(data[0], data[1]);
+    const char *text = reinterpret_cast<const char *>(data);
+    harness::forEachLine(text + 2, text + size, [&](const char *, const char *) { ++shape.documents; });
+    return shape;
+}
@@ -0,0 +1,93 @@
+// main2.cpp's runTestcase and testcaseShape, shared with bench.cpp so its
+// BM_Exec times exactly what the harness runs. Include after harness.h,
+// which takes the HARNESS_* macros of the including file.
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <jsoncpp/json/json.h>
+#include "harness.h"
+#include "json_encoder.h"
+#include "token_weights.h"
+
+// Your line-based harness, now using JsonEncoder on each line.
+// Testcase layout: two option bytes A,B, then encoder inputs framed by
+// HARNESS_FRAMING (one per line by default).
+static void runTestcase(const uint8_t *data, size_t size) {
+    if (size < 2)
+        return;
+    harness::echo(reinterpret_cast<const char *>(data), 2);  // A,B
+    const unsigned mask = harness::optionMask(data[0], data[1]);
+    harness::maskStats().testcase(mask);
+
+    static char arena[JsonEncoder::outputBound(ENCODER_MAX_NODES)];
+    harness::loadTokenWeights();      // ENCODER_TOKEN_WEIGHTS, first call only
+    harness::TokenFeedback &feedback = harness::tokenFeedback();
+    feedback.beginExec();
+
+    const char *text = reinterpret_cast<const char *>(data);
+    harness::forEachDocument(text + 2, text + size, [&](const char *p, const char *docEnd) {
+        // Treat the document bytes as input *to the encoder*, not as JSON yet.
+        const uint8_t *line = reinterpret_cast<const uint8_t *>(p);
+        JsonEncoder enc(line, docEnd - p, ENCODER_MAX_DEPTH, ENCODER_MAX_NODES);
+        feedback.document(line, docEnd - p, ENCODER_MAX_DEPTH, ENCODER_MAX_NODES);
+        // Written into a fixed arena sized for the worst case: no allocation
+        std::string_view json;
+        {
+            harness::StageTimer timer(harness::Stage::Encode);
+            json = enc.encodeIterativeInto(arena);  // always syntactically valid (per our design)
+            timer.bytesIn(enc.consumed());
+            timer.bytesOut(json.size());
+        }
+        harness::echo(json);            // optionally print the generated JSON
+        harness::echo("\n");
+        harness::ParseRoot parsed;      // recycled with -DHARNESS_VALUE_ARENA
+        Json::Value &root = parsed.get();
+        std::string errs;
+
+        // Built once per option mask and reused (see ReaderCache)
+        Json::CharReader &reader = harness::readerCache().get(mask);
+
+        bool ok;
+        try {
+            harness::StageTimer timer(harness::Stage::Parse, json.size());
+            ok = reader.parse(
+                json.data(),
+                json.data() + json.size(),
+                &root,
+                &errs
+            );
+        } catch (const Json::Exception &e) {
+            // OurReader throws once nesting passes its stackLimit, which
+            // documents deeper than ENCODER_MAX_DEPTH 1000 reach on purpose.
+            ok = false;
+            errs = e.what();
+        }
+        harness::maskStats().document(mask, ok, errs);
+
+        if (ok) {
+            harness::roundTrip(root);   // -DHARNESS_ROUNDTRIP
+            //harness::echo("OK\n");
+        } else {
+            //harness::echo(errs);
+        }
+        return enc.consumed();
+    });
+    feedback.endExec();
+}
+
+// For --profile-replay: the mask and what the encoder makes of each document.
+static harness::Shape testcaseShape(const uint8_t *data, size_t size) {
+    harness::Shape shape;
+    if (size < 2)
+        return shape;
+    shape.mask = harness::optionMask(data[0], data[1]);
+    const char *text = reinterpret_cast<const char *>(data);
+    harness::forEachDocument(text + 2, text + size, [&](const char *p, const char *docEnd) {
+        JsonEncoder enc(reinterpret_cast<const uint8_t *>(p), docEnd - p, ENCODER_MAX_DEPTH, ENCODER_MAX_NODES);
+        shape.addEncoded(enc.extent());
+        return enc.consumed();
+    });
+    return shape;
+}
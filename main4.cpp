@@ -0,0 +1,165 @@
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <jsoncpp/json/json.h>
+#include "harness_alloc.h"
+#include "harness.h"
+#include "json_encoder.h"
+
+// Large-document harness: stresses OurReader and Json::Value with
+// multi-megabyte documents grown from a small encoder seed.
+// Testcase layout: two option bytes A,B, a fanout byte F, then the seed.
+// The seed is repeated up to LARGE_INPUT_BYTES with F & 7 OR'd into every
+// byte, which raises container sizes to at least F (scalar tokens ignore
+// those bits), and the whole buffer is encoded as one document with the
+// LARGE_MAX_NODES / LARGE_MAX_DEPTH limits instead of ENCODER_MAX_*.
+//
+// Each parse reports its allocations per parsed node (encoder values read;
+// objects keep fewer, duplicate keys overwrite) and its heap peak. Echo
+// builds print one line per testcase; HARNESS_STATS=1 adds a summary with
+// the process peak RSS at exit. Build with and without -DHARNESS_VALUE_ARENA
+// to compare malloc calls per node with the tree in the value arena
+// (arena_allocs) against plain operator new.
+
+// Encoder input bytes after expansion (each node reads one or two).
+#ifndef LARGE_INPUT_BYTES
+#define LARGE_INPUT_BYTES (1 << 20)
+#endif
+
+// Node budget; outputBound(1 << 18) is ~33 MB of arena.
+#ifndef LARGE_MAX_NODES
+#define LARGE_MAX_NODES (1 << 18)
+#endif
+
+#ifndef LARGE_MAX_DEPTH
+#define LARGE_MAX_DEPTH 64
+#endif
+
+namespace {
+
+struct LargeStats {
+    uint64_t docs = 0;
+    uint64_t failed = 0;
+    uint64_t jsonBytes = 0;
+    uint64_t maxJsonBytes = 0;
+    uint64_t nodes = 0;
+    uint64_t allocs = 0;
+    uint64_t arenaAllocs = 0;
+    uint64_t maxPeakHeap = 0;
+
+    ~LargeStats() {
+        if (!harness::statsEnabled() || docs == 0)
+            return;
+        std::fprintf(stderr,
+                     "[harness] large documents: %llu parsed (%llu failed), %.1f MB JSON "
+                     "(largest %.1f MB), %.2f allocs per node (+%.2f from the value arena), "
+                     "parse heap peak %.1f MB, peak RSS %.1f MB\n",
+                     static_cast<unsigned long long>(docs),
+                     static_cast<unsigned long long>(failed),
+                     jsonBytes / 1e6, maxJsonBytes / 1e6,
+                     nodes ? static_cast<double>(allocs) / nodes : 0.0,
+                     nodes ? static_cast<double>(arenaAllocs) / nodes : 0.0,
+                     maxPeakHeap / 1e6, harness::alloc::peakRssMb());
+    }
+};
+
+LargeStats &largeStats() {
+    static LargeStats stats;
+    return stats;
+}
+
+// Nodes in a parsed tree, counted with an explicit stack.
+size_t countValues(const Json::Value &root) {
+    size_t count = 0;
+    std::vector<const Json::Value *> stack{&root};
+    while (!stack.empty()) {
+        const Json::Value *v = stack.back();
+        stack.pop_back();
+        ++count;
+        if (v->isArray() || v->isObject()) {
+            for (const Json::Value &child : *v)
+                stack.push_back(&child);
+        }
+    }
+    return count;
+}
+
+} // namespace
+
+static void runTestcase(const uint8_t *data, size_t size) {
+    if (size < 4)
+        return;
+    const unsigned mask = harness::optionMask(data[0], data[1]);
+    const uint8_t fanout = data[2] & 0x07;
+    const uint8_t *seed = data + 3;
+    const size_t seedSize = size - 3;
+
+    // Both reused across testcases: the arena alone is tens of MB
+    static std::vector<uint8_t> input(LARGE_INPUT_BYTES);
+    static std::vector<char> arena(JsonEncoder::outputBound(LARGE_MAX_NODES));
+
+    for (size_t i = 0, s = 0; i < input.size(); ++i, s = s + 1 == seedSize ? 0 : s + 1)
+        input[i] = seed[s] | fanout;
+
+    JsonEncoder enc(input.data(), input.size(), LARGE_MAX_DEPTH, LARGE_MAX_NODES);
+    std::string_view json;
+    {
+        harness::StageTimer timer(harness::Stage::Encode);
+        json = enc.encodeIterativeInto(arena.data());
+        timer.bytesIn(enc.consumed());
+        timer.bytesOut(json.size());
+    }
+
+    Json::CharReader &reader = harness::readerCache().get(mask);
+
+    const harness::alloc::Counters before = harness::alloc::counters;
+    harness::alloc::resetPeak();
+    bool ok;
+    size_t values = 0;
+    uint64_t allocs, arenaAllocs, peakHeap;
+    {
+        harness::ParseRoot parsed;      // recycled with -DHARNESS_VALUE_ARENA
+        Json::Value &root = parsed.get();
+        std::string errs;
+        try {
+            harness::StageTimer timer(harness::Stage::Parse, json.size());
+            ok = reader.parse(json.data(), json.data() + json.size(), &root, &errs);
+        } catch (const Json::Exception &) {
+            // stackLimit, as in main2.cpp
+            ok = false;
+        }
+        if (ok)
+            values = countValues(root);
+        allocs = harness::alloc::counters.calls - before.calls;
+        arenaAllocs = harness::alloc::counters.arenaCalls - before.arenaCalls;
+        peakHeap = harness::alloc::counters.peakLive - before.live;
+        if (ok)
+            harness::roundTrip(root);   // -DHARNESS_ROUNDTRIP, outside the counts
+    }
+
+    LargeStats &stats = largeStats();
+    ++stats.docs;
+    stats.failed += !ok;
+    stats.jsonBytes += json.size();
+    stats.maxJsonBytes = std::max<uint64_t>(stats.maxJsonBytes, json.size());
+    if (ok) {
+        stats.nodes += enc.nodeCount();
+        stats.allocs += allocs;
+        stats.arenaAllocs += arenaAllocs;
+    }
+    stats.maxPeakHeap = std::max(stats.maxPeakHeap, peakHeap);
+
+    if (harness::kEcho) {
+        char line[256];
+        int n = std::snprintf(line, sizeof(line),
+                              "%s json_bytes=%zu nodes=%zu kept_values=%zu allocs=%llu "
+                              "allocs_per_node=%.2f arena_allocs=%llu heap_peak_kb=%llu\n",
+                              ok ? "OK" : "ERR", json.size(), enc.nodeCount(), values,
+                              static_cast<unsigned long long>(allocs),
+                              static_cast<double>(allocs) / (enc.nodeCount() ? enc.nodeCount() : 1),
+                              static_cast<unsigned long long>(arenaAllocs),
+                              static_cast<unsigned long long>(peakHeap / 1024));
+        harness::echo(line, static_cast<size_t>(n));
+    }
+}
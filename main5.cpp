@@ -0,0 +1,73 @@
+#include <string>
+#include <string_view>
+#include <memory>
+#include <cstdint>
+#include <jsoncpp/json/json.h>
+#include "harness.h"
+#include "json_encoder.h"
+
+// Compact-format harness: main2.cpp's encode + parse, reading testcases in
+// the compact v1 layout (json_format::Compact). The header replaces the A,B
+// option bytes and also carries the depth limit and node budget, so one
+// campaign covers all of them; the documents follow back to back, each
+// ending where its structure does, and no framing bytes are spent.
+//
+// Header limits of 0 mean ENCODER_MAX_DEPTH / ENCODER_MAX_NODES. Larger
+// values are clamped to JsonEncoder::kMaxStackDepth and ENCODER_MAX_NODES
+// (the arena is sized for it). Testcases without a v1 header are ignored.
+// `encoder --compact` converts main2.cpp queues into this layout. Echo builds
+// print the same bytes main2.cpp does for the converted testcase.
+static void runTestcase(const uint8_t *data, size_t size) {
+    json_format::Header header;
+    size_t pos = json_format::readHeader(data, size, header);
+    if (pos == 0)
+        return;
+    const unsigned mask = header.mask & (harness::ReaderCache::kNumMasks - 1);
+    const size_t maxDepth = header.maxDepth == 0 ? ENCODER_MAX_DEPTH
+                          : header.maxDepth < JsonEncoder::kMaxStackDepth ? header.maxDepth
+                          : JsonEncoder::kMaxStackDepth;
+    const size_t maxNodes = header.maxNodes == 0 || header.maxNodes > ENCODER_MAX_NODES
+                          ? ENCODER_MAX_NODES : header.maxNodes;
+    const char ab[2] = {static_cast<char>(mask & 0xff), static_cast<char>(mask >> 8)};
+    harness::echo(ab, 2);
+    harness::maskStats().testcase(mask);
+
+    static char arena[CompactEncoder::outputBound(ENCODER_MAX_NODES)];
+
+    while (pos < size) {
+        CompactEncoder enc(data + pos, size - pos, maxDepth, maxNodes);
+        std::string_view json;
+        {
+            harness::StageTimer timer(harness::Stage::Encode);
+            json = enc.encodeIterativeInto(arena);
+            timer.bytesIn(enc.consumed());
+            timer.bytesOut(json.size());
+        }
+        harness::echo(json);
+        harness::echo("\n");
+        harness::ParseRoot parsed;      // recycled with -DHARNESS_VALUE_ARENA
+        Json::Value &root = parsed.get();
+        std::string errs;
+
+        // Built once per option mask and reused (see ReaderCache)
+        Json::CharReader &reader = harness::readerCache().get(mask);
+
+        bool ok;
+        try {
+            harness::StageTimer timer(harness::Stage::Parse, json.size());
+            ok = reader.parse(json.data(), json.data() + json.size(), &root, &errs);
+        } catch (const Json::Exception &e) {
+            // stackLimit, as in main2.cpp
+            ok = false;
+            errs = e.what();
+        }
+        harness::maskStats().document(mask, ok, errs);
+        if (ok)
+            harness::roundTrip(root);   // -DHARNESS_ROUNDTRIP
+
+        // Only a zero limit reads nothing; stop rather than loop
+        if (enc.consumed() == 0)
+            break;
+        pos += enc.consumed();
+    }
+}
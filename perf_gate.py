@@ -0,0 +1,308 @@
+#!/usr/bin/env python3
+"""Harness performance gate: time every variant on a fixed corpus slice,
+keep the results in a JSON history and fail when one regresses.
+
+Each variant (main.cpp, main2.cpp and main3.cpp built with $CXX, and their
+persistent-mode afl-clang-fast++ builds when that compiler is found) is
+built with -DHARNESS_ECHO=0 -DHARNESS_COUNT_ALLOCS and runs
+
+    harness --profile-replay RUNS --summary FILE SLICE...
+
+--repeats times, interleaved with the other variants. The best run gives
+documents per CPU second, operator new calls per exec and peak RSS. The
+baseline for each metric is the median of the last --window passing
+entries of the history that share the host, the corpus slice and the
+variant's build (its name, for --variant); a variant more than --threshold
+percent slower, or allocating or resident more, fails the gate (exit
+status 1). Passing runs are appended to the history; failing ones only
+with --accept.
+
+The slice is picked once per set of queues and --slice and its file list
+kept in the history, so later runs time the same files while the queues
+keep growing. --reslice picks a new one, which starts new baselines.
+
+    python3 perf_gate.py                          # gate against perf_history.json
+    python3 perf_gate.py --accept --label "new reader cache"
+    python3 perf_gate.py --variant main3-strict=./jsoncpp_strict
+"""
+
+import argparse
+import hashlib
+import json
+import os
+import platform
+import shutil
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+from pathlib import Path
+
+SOURCES = ["main.cpp", "main2.cpp", "main3.cpp"]
+BUILD_FLAGS = ["-O2", "-std=c++17", "-pthread", "-DHARNESS_ECHO=0", "-DHARNESS_COUNT_ALLOCS"]
+
+# (--summary key, larger is better)
+METRICS = [
+    ("docs_per_sec", True),
+    ("allocs_per_exec", False),
+    ("peak_rss_kb", False),
+]
+
+
+def corpus_slice(dirs, per_dir):
+    """per_dir queue entries from each dir, evenly spread over its sorted names.
+
+    Queue names start with the entry id, so the slice covers early seeds and
+    late, deeper finds alike, and stays the same while the queue does.
+    """
+    paths = []
+    for d in dirs:
+        entries = sorted(p for p in Path(d).iterdir() if p.is_file() and not p.name.startswith("."))
+        if not entries:
+            sys.exit(f"[!] No queue entries in {d}")
+        step = max(1, len(entries) / per_dir)
+        picked = sorted({int(k * step) for k in range(min(per_dir, len(entries)))})
+        paths.extend(entries[i] for i in picked)
+    return paths
+
+
+def fingerprint(paths):
+    digest = hashlib.sha256()
+    for p in paths:
+        digest.update(p.name.encode() + b"\0")
+        digest.update(hashlib.sha256(p.read_bytes()).digest())
+    return digest.hexdigest()[:16]
+
+
+def compiler_id(cxx):
+    try:
+        out = subprocess.run([cxx, "--version"], capture_output=True, text=True, check=True).stdout
+    except (OSError, subprocess.CalledProcessError):
+        return None
+    return out.splitlines()[0].strip() if out else cxx
+
+
+def build(cxx, source, binary, cxxflags, ldflags):
+    cmd = [cxx, *BUILD_FLAGS, *cxxflags, source, *ldflags, "-o", str(binary)]
+    env = dict(os.environ, AFL_QUIET="1")
+    result = subprocess.run(cmd, capture_output=True, text=True, env=env)
+    if result.returncode != 0:
+        sys.exit(f"[!] Build failed: {' '.join(cmd)}\n{result.stderr}")
+
+
+def run_variant(binary, runs, paths, workdir):
+    summary = Path(workdir) / "summary.json"
+    cmd = [binary, "--profile-replay", str(runs), "--top", "0", "--summary", str(summary),
+           *(str(p) for p in paths)]
+    result = subprocess.run(cmd, stdin=subprocess.DEVNULL, stdout=subprocess.DEVNULL,
+                            stderr=subprocess.PIPE, text=True)
+    if result.returncode != 0 or not summary.is_file():
+        sys.exit(f"[!] {binary} exited with {result.returncode}:\n{result.stderr[-2000:]}")
+    data = json.loads(summary.read_text())
+    summary.unlink()
+    if data["docs_per_sec"] is None:
+        # No testcaseShape in this harness: gate on execs instead
+        data["docs_per_sec"] = data["execs_per_sec"]
+    return data
+
+
+def best(samples):
+    result = {}
+    for key, larger_better in METRICS:
+        values = [s[key] for s in samples if s[key] is not None]
+        result[key] = (max(values) if larger_better else min(values)) if values else None
+    result["execs_per_sec"] = max(s["execs_per_sec"] for s in samples)
+    result["inputs"] = samples[0]["inputs"]
+    return result
+
+
+def pinned_slice(history, corpora, per_dir, reslice):
+    """The slice recorded for these queues and --slice, or a new one.
+
+    Returns (paths, record); record is the history's "slices" item to add,
+    or None when the recorded slice was reused.
+    """
+    key = {"corpora": [str(Path(d)) for d in corpora], "per_dir": per_dir}
+    for pinned in reversed(history.get("slices", [])):
+        if reslice or {k: pinned[k] for k in key} != key:
+            continue
+        paths = [Path(f) for f in pinned["files"]]
+        missing = [str(p) for p in paths if not p.is_file()]
+        if missing:
+            sys.exit(f"[!] {len(missing)} files of the pinned slice are gone (first: {missing[0]}); "
+                     f"rerun with --reslice to pick a new slice")
+        return paths, None
+    paths = corpus_slice(corpora, per_dir)
+    return paths, dict(key, files=[str(p) for p in paths], corpus=fingerprint(paths))
+
+
+def load_history(path):
+    if not path.is_file():
+        return {"version": 1, "entries": []}
+    history = json.loads(path.read_text())
+    if history.get("version") != 1:
+        sys.exit(f"[!] {path}: unknown history version {history.get('version')}")
+    return history
+
+
+def baseline(history, host, corpus, runs, name, build_id, window):
+    """Per metric, the median over the last `window` comparable entries."""
+    recent = [e["variants"][name] for e in history["entries"]
+              if e["host"] == host and e["corpus"] == corpus and e["runs"] == runs
+              and name in e["variants"] and e["variants"][name]["build"] == build_id][-window:]
+    if not recent:
+        return None, 0
+    base = {}
+    for key, _ in METRICS:
+        values = [r[key] for r in recent if r.get(key) is not None]
+        base[key] = statistics.median(values) if values else None
+    return base, len(recent)
+
+
+def git_commit():
+    try:
+        commit = subprocess.run(["git", "rev-parse", "--short", "HEAD"], capture_output=True,
+                                text=True, check=True).stdout.strip()
+        dirty = subprocess.run(["git", "status", "--porcelain", "--untracked-files=no"],
+                               capture_output=True, text=True, check=True).stdout.strip()
+    except (OSError, subprocess.CalledProcessError):
+        return None
+    return commit + ("-dirty" if dirty else "")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Benchmark-gated harness regression tracking")
+    parser.add_argument("--corpus", action="append", default=[], metavar="DIR",
+                        help="Queue to slice; repeat for several (default: out2 and out3 queues)")
+    parser.add_argument("--slice", type=int, default=400, help="Entries taken from each queue")
+    parser.add_argument("--reslice", action="store_true",
+                        help="Pick a new slice instead of the one pinned in the history")
+    parser.add_argument("--runs", type=int, default=5, help="Timed runs per input (--profile-replay K)")
+    parser.add_argument("--repeats", type=int, default=3, help="Replays per variant; the best counts")
+    parser.add_argument("--history", default="perf_history.json", help="JSON history file")
+    parser.add_argument("--threshold", type=float, default=10.0, help="Allowed regression, percent")
+    parser.add_argument("--window", type=int, default=5, help="History entries in the baseline")
+    parser.add_argument("--variant", action="append", default=[], metavar="NAME=BINARY",
+                        help="Prebuilt harness to gate instead of building the defaults; repeatable")
+    parser.add_argument("--cxx", default=os.environ.get("CXX", "g++"), help="Compiler for the plain builds")
+    parser.add_argument("--afl-cxx", default="afl-clang-fast++",
+                        help="Compiler for the persistent builds ('' to skip them)")
+    parser.add_argument("--cxxflags", default="", help="Extra compile flags")
+    parser.add_argument("--ldflags", default="-ljsoncpp", help="Link flags")
+    parser.add_argument("--build-dir", default="perf_build", help="Where the variants are built")
+    parser.add_argument("--label", default="", help="Note stored with this entry")
+    parser.add_argument("--accept", action="store_true", help="Record this run even if it regresses")
+    parser.add_argument("--no-record", action="store_true", help="Never write the history")
+    args = parser.parse_args()
+
+    corpora = args.corpus or ["out2/default/queue", "out3/default/queue"]
+    for d in corpora:
+        if not Path(d).is_dir():
+            sys.exit(f"[!] Corpus not found: {d}")
+    history_path = Path(args.history)
+    history = load_history(history_path)
+    paths, new_slice = pinned_slice(history, corpora, args.slice, args.reslice)
+    corpus = fingerprint(paths)
+
+    variants = []  # (name, binary, build id)
+    if args.variant:
+        for spec in args.variant:
+            name, sep, binary = spec.partition("=")
+            if not sep or not name:
+                parser.error(f"bad --variant {spec!r}: want NAME=BINARY")
+            if not Path(binary).is_file():
+                sys.exit(f"[!] Harness not found: {binary}")
+            # Keyed on the name: a rebuilt binary is what the gate is meant to compare
+            variants.append((name, str(Path(binary).resolve()), f"variant {name}"))
+    else:
+        build_dir = Path(args.build_dir)
+        build_dir.mkdir(parents=True, exist_ok=True)
+        compilers = [("", args.cxx)]
+        if args.afl_cxx:
+            if shutil.which(args.afl_cxx):
+                compilers.append(("-afl", args.afl_cxx))
+            else:
+                print(f"[!] {args.afl_cxx} not found; skipping the persistent builds")
+        cxxflags, ldflags = args.cxxflags.split(), args.ldflags.split()
+        for suffix, cxx in compilers:
+            cid = compiler_id(cxx)
+            if cid is None:
+                sys.exit(f"[!] Compiler not found: {cxx}")
+            for source in SOURCES:
+                name = Path(source).stem + suffix
+                binary = build_dir / name
+                print(f"[*] Building {name} with {cxx}")
+                build(cxx, source, binary, cxxflags, ldflags)
+                build_id = " ".join([cid, *BUILD_FLAGS, *cxxflags, *ldflags])
+                variants.append((name, str(binary.resolve()), build_id))
+
+    print(f"[*] {len(paths)} inputs from {', '.join(corpora)} ({'new' if new_slice else 'pinned'} slice {corpus}), "
+          f"{args.repeats} x --profile-replay {args.runs} per variant")
+    samples = {name: [] for name, _, _ in variants}
+    with tempfile.TemporaryDirectory() as workdir:
+        for _ in range(max(1, args.repeats)):
+            for name, binary, _ in variants:
+                samples[name].append(run_variant(binary, args.runs, paths, workdir))
+
+    host = platform.node()
+    entry_variants = {}
+    regressions = []
+    print(f"\n{'variant':<12} {'docs/s':>12} {'allocs/exec':>12} {'peak RSS':>10}   vs baseline")
+    for name, binary, build_id in variants:
+        result = best(samples[name])
+        result["build"] = build_id
+        result["binary_sha256"] = hashlib.sha256(Path(binary).read_bytes()).hexdigest()[:16]
+        entry_variants[name] = result
+        base, count = baseline(history, host, corpus, args.runs, name, build_id, args.window)
+        notes = []
+        if base is None:
+            notes.append("no baseline yet")
+        else:
+            for key, larger_better in METRICS:
+                now, then = result[key], base[key]
+                if now is None or not then:
+                    continue
+                change = (now - then) / then * 100
+                worse = -change if larger_better else change
+                if worse > args.threshold:
+                    regressions.append(f"{name} {key}: {now:.1f} vs {then:.1f} ({change:+.1f}%)")
+                notes.append(f"{key} {change:+.1f}%{' REGRESSED' if worse > args.threshold else ''}")
+            notes.append(f"(median of {count})")
+        allocs = result["allocs_per_exec"]
+        print(f"{name:<12} {result['docs_per_sec']:>12.0f} "
+              f"{allocs if allocs is not None else float('nan'):>12.2f} "
+              f"{result['peak_rss_kb'] / 1024:>8.1f}MB   {', '.join(notes)}")
+
+    if regressions:
+        print(f"\n[!] {len(regressions)} regression(s) over {args.threshold:g}%:")
+        for r in regressions:
+            print(f"    {r}")
+    else:
+        print(f"\n[*] No regression over {args.threshold:g}%")
+
+    record = not args.no_record and (not regressions or args.accept)
+    if new_slice and not args.no_record:
+        # Pinned even by a failing run, so its rerun times the same files
+        history.setdefault("slices", []).append(new_slice)
+        history_path.write_text(json.dumps(history, indent=1) + "\n")
+        print(f"[*] Pinned slice {corpus} ({len(paths)} files) in {history_path}")
+    if record:
+        history["entries"].append({
+            "time": time.strftime("%Y-%m-%dT%H:%M:%S%z"),
+            "commit": git_commit(),
+            "label": args.label,
+            "host": host,
+            "corpus": corpus,
+            "runs": args.runs,
+            "variants": entry_variants,
+        })
+        history_path.write_text(json.dumps(history, indent=1) + "\n")
+        print(f"[*] Recorded in {history_path} ({len(history['entries'])} entries)")
+    elif regressions and not args.no_record:
+        print(f"[*] Not recorded in {history_path}; rerun with --accept to make this the new normal")
+    sys.exit(1 if regressions else 0)
+
+
+if __name__ == "__main__":
+    main()
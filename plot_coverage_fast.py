@@ -7,12 +7,24 @@ import shutil
 import argparse
 from pathlib import Path
 import matplotlib.pyplot as plt
+from queue_archive import QueueArchive, is_archive
 
 def parse_queue_files(queue_dir):
-    """Parse queue directory and extract timestamps (in seconds)."""
+    """Parse queue directory and extract timestamps (in seconds).
+
+    queue_dir may also be a queue archive (queue_archive.py pack); its index
+    has the times, and the entries come back as ARCHIVE.qar#INDEX members.
+    """
     queue_path = Path(queue_dir)
     if not queue_path.exists():
         raise FileNotFoundError(f"Queue directory not found: {queue_dir}")
+
+    if is_archive(queue_path):
+        with QueueArchive(queue_path) as archive:
+            queue_files = [(e.time_ms / 1000.0, archive.member(e))
+                           for e in archive.entries if e.time_ms is not None]
+        queue_files.sort(key=lambda x: x[0])
+        return queue_files
     
     queue_files = []
     time_pattern = re.compile(r'time:(\d+)')
@@ -27,119 +39,127 @@ def parse_queue_files(queue_dir):
     queue_files.sort(key=lambda x: x[0])
     return queue_files
 
-def run_coverage_batch(harness_bin, queue_files, profraw_dir):
-    """Run all queue files through coverage harness (like coverage.sh)."""
-    print(f"[*] Running {len(queue_files)} inputs through coverage harness...")
-    
-    profraw_dir = Path(profraw_dir)
-    if profraw_dir.exists():
-        shutil.rmtree(profraw_dir)
-    profraw_dir.mkdir(parents=True)
-    
-    for idx, (time_sec, file_path) in enumerate(queue_files):
-        if (idx + 1) % 100 == 0:
-            print(f"    Progress: {idx + 1}/{len(queue_files)}")
-        
-        env = os.environ.copy()
-        # Use index as profraw filename so we can track which file it came from
-        env["LLVM_PROFILE_FILE"] = str(profraw_dir / f"{idx:06d}.profraw")
-        
-        with open(file_path, 'rb') as f:
-            subprocess.run(
-                [str(harness_bin)],
-                stdin=f,
-                stdout=subprocess.DEVNULL,
-                stderr=subprocess.DEVNULL,
-                env=env,
-                check=False
-            )
-    
-    print(f"[+] Collected {len(list(profraw_dir.glob('*.profraw')))} coverage profiles")
-
-def get_cumulative_coverage(profraw_dir, harness_bin, queue_files, time_shift=0):
+def run_coverage_batch(harness_bin, queue_files, bits_dir, jobs=None):
+    """Replay all queue files in-process, one counter bitset per input.
+
+    The harness --replay mode runs a slice of the queue per process and,
+    with --counter-dir, writes bits_dir/<index>.bits after every input: the
+    profile counters it hit, read from memory and reset. A crashing input
+    kills its worker, so the rest of that slice is resumed in a fresh
+    process; the crasher just has no bitset.
     """
-    Compute cumulative coverage over time by merging profraw files incrementally.
-    
-    Returns list of (time, branches_covered, branches_total)
+    jobs = jobs or os.cpu_count() or 1
+    print(f"[*] Running {len(queue_files)} inputs through coverage harness ({jobs} workers)...")
+
+    bits_dir = Path(bits_dir)
+    if bits_dir.exists():
+        shutil.rmtree(bits_dir)
+    bits_dir.mkdir(parents=True)
+
+    env = os.environ.copy()
+    # The runtime's at-exit .profraw is not needed
+    env["LLVM_PROFILE_FILE"] = str(bits_dir / "worker-%p.profraw.tmp")
+
+    def start(begin, end):
+        cmd = [str(harness_bin), "--replay",
+               "--counter-dir", str(bits_dir),
+               "--index-base", str(begin),
+               *[str(path) for _, path in queue_files[begin:end]]]
+        return subprocess.Popen(cmd, stdout=subprocess.DEVNULL,
+                                stderr=subprocess.DEVNULL, env=env)
+
+    per_worker = (len(queue_files) + jobs - 1) // jobs
+    pending = [(begin, min(begin + per_worker, len(queue_files)))
+               for begin in range(0, len(queue_files), per_worker)]
+    running = []
+    while pending or running:
+        while pending and len(running) < jobs:
+            begin, end = pending.pop()
+            running.append((start(begin, end), begin, end))
+        proc, begin, end = running.pop(0)
+        if proc.wait() == 0:
+            continue
+        # Skip past the first input of the slice without a bitset
+        done = begin
+        while done < end and (bits_dir / f"{done:06d}.bits").exists():
+            done += 1
+        print(f"    [!] input {done} crashed the harness; resuming after it")
+        if done + 1 < end:
+            pending.append((done + 1, end))
+
+    for tmp in bits_dir.glob("*.profraw.tmp"):
+        tmp.unlink()
+    collected = len(list(bits_dir.glob("*.bits")))
+    if queue_files and not collected:
+        raise RuntimeError(f"{harness_bin} wrote no counter bitsets; is it a -fprofile-instr-generate build?")
+    print(f"[+] Collected {collected} counter bitsets")
+
+def input_counter_bits(path):
     """
-    profraw_dir = Path(profraw_dir)
-    profraw_files = sorted(profraw_dir.glob("*.profraw"))
-    
-    if not profraw_files:
-        return []
-    
+    Profile counters one input hit, as a bitset (bit i is counter i), from
+    the .bits file the harness wrote: a little-endian uint64 counter count,
+    then the bits, least significant first.
+
+    Returns (bits, total), or (0, None) if the input has no bitset. A
+    counter is non-zero in a merge of profiles iff it is non-zero in one of
+    them, so OR-ing these bitsets gives what a merged profile covers.
+    """
+    if not path.exists():
+        return 0, None
+    data = path.read_bytes()
+    total = int.from_bytes(data[:8], "little")
+    return int.from_bytes(data[8:], "little"), total
+
+def get_cumulative_coverage(bits_dir, queue_files, time_shift=0):
+    """
+    Compute cumulative coverage over time as a running union of per-input
+    counter bitsets, in a single linear pass over the queue.
+
+    Returns list of (time, counters_covered, counters_total), one per queue entry
+    """
+    bits_dir = Path(bits_dir)
+    print(f"[*] Computing cumulative coverage at all {len(queue_files)} queue entries...")
+
     results = []
-    
-    # Sample at intervals to speed things up
-    sample_points = [0, 10, 20, 50, 100, 200, 500, 1000, len(profraw_files)-1]
-    sample_points = [i for i in sample_points if i < len(profraw_files)]
-    
-    # Always add the last point
-    if len(profraw_files) - 1 not in sample_points:
-        sample_points.append(len(profraw_files) - 1)
-    
-    print(f"[*] Computing cumulative coverage at {len(sample_points)} sample points...")
-    
-    for sample_idx in sample_points:
-        # Merge profraw files up to this point
-        files_to_merge = profraw_files[:sample_idx + 1]
-        
-        temp_profdata = profraw_dir.parent / f"temp_{sample_idx}.profdata"
-        
-        merge_cmd = [
-            "llvm-profdata", "merge",
-            "-o", str(temp_profdata),
-            *[str(f) for f in files_to_merge]
-        ]
-        subprocess.run(merge_cmd, check=True, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
-        
-        # Get coverage report
-        report_cmd = [
-            "llvm-cov", "report",
-            str(harness_bin),
-            f"-instr-profile={temp_profdata}"
-        ]
-        result = subprocess.run(report_cmd, capture_output=True, text=True, check=True)
-        
-        # Parse branches
-        branches_covered, branches_total = parse_coverage_report(result.stdout)
-        
-        # Get the time from the corresponding queue file
-        time_sec, _ = queue_files[sample_idx]
+    covered = 0
+    counters_total = 0
+    for idx in range(len(queue_files)):
+        path = bits_dir / f"{idx:06d}.bits"
+        bits, total = input_counter_bits(path)
+        if total is not None:
+            if counters_total and total != counters_total:
+                raise RuntimeError(f"{path}: {total} counters, expected {counters_total}")
+            counters_total = total
+        covered |= bits
+
+        time_sec, _ = queue_files[idx]
         adjusted_time = time_sec + time_shift
-        
+
         # For log scale, ensure time is at least 1 second
         if adjusted_time < 1:
             adjusted_time = 1
-        
-        results.append((adjusted_time, branches_covered, branches_total))
-        
-        print(f"    File {sample_idx + 1}/{len(profraw_files)}: {branches_covered}/{branches_total} branches at {adjusted_time:.1f}s")
-        
-        # Clean up temp file
-        temp_profdata.unlink()
-    
+
+        counters_covered = bin(covered).count("1")
+        results.append((adjusted_time, counters_covered, counters_total))
+
+        if (idx + 1) % 500 == 0 or idx + 1 == len(queue_files):
+            print(f"    File {idx + 1}/{len(queue_files)}: {counters_covered}/{counters_total} counters at {adjusted_time:.1f}s")
+
     return results
 
-def parse_coverage_report(report_text):
-    """Parse llvm-cov report to extract branch coverage."""
-    lines = report_text.strip().split('\n')
-    
-    for line in reversed(lines):
-        if line.startswith('TOTAL'):
-            parts = line.split()
-            if len(parts) >= 13:
-                try:
-                    branches_total = int(parts[10])
-                    branches_missed = int(parts[11])
-                    branches_covered = branches_total - branches_missed
-                    return branches_covered, branches_total
-                except (ValueError, IndexError):
-                    pass
-    
-    return 0, 0
-
-def plot_comparison(runs_data, labels, output_file, log_scale=False):
+def read_snapshot_csv(csv_path, time_shift=0):
+    """(seconds, edges) rows a HARNESS_COV_SNAPSHOT campaign wrote to FILE.csv."""
+    data = []
+    with open(csv_path) as f:
+        for line in f:
+            if line.startswith("#") or not line.strip():
+                continue
+            relative_time, _unix_time, _execs, edges = (x.strip() for x in line.split(","))
+            data.append((float(relative_time) + time_shift, int(edges)))
+    data.sort()
+    return data
+
+def plot_comparison(runs_data, labels, output_file, log_scale=False, ylabel='Branch Coverage'):
     """Generate comparison plot."""
     plt.figure(figsize=(12, 7))
     
@@ -155,7 +175,9 @@ def plot_comparison(runs_data, labels, output_file, log_scale=False):
         label = labels.get(run_name, run_name)
         color = colors[idx % len(colors)]
         
-        plt.plot(times, branches, marker='o', linewidth=2, 
+        # Full-resolution curves have one point per queue entry
+        marker = 'o' if len(data) <= 50 else None
+        plt.plot(times, branches, marker=marker, linewidth=2,
                 markersize=6, label=label, color=color)
     
     if log_scale:
@@ -164,7 +186,7 @@ def plot_comparison(runs_data, labels, output_file, log_scale=False):
     else:
         plt.xlabel('Time (seconds)', fontsize=12, fontweight='bold')
     
-    plt.ylabel('Branch Coverage', fontsize=12, fontweight='bold')
+    plt.ylabel(ylabel, fontsize=12, fontweight='bold')
     plt.title('Fuzzer Coverage Comparison Over Time', fontsize=14, fontweight='bold')
     plt.legend(fontsize=11, loc='lower right')
     plt.grid(True, alpha=0.3, linestyle='--')
@@ -175,12 +197,16 @@ def plot_comparison(runs_data, labels, output_file, log_scale=False):
 
 def main():
     parser = argparse.ArgumentParser(description="Fast coverage plotter")
-    parser.add_argument("--runs", required=True, help="Colon-separated list of output directories")
+    parser.add_argument("--runs", required=True,
+                        help="Colon-separated list of output directories or queue archives (.qar)")
     parser.add_argument("--labels", help="Colon-separated list of labels")
     parser.add_argument("--time-shifts", help="Colon-separated list of time shifts in seconds")
     parser.add_argument("--output", default="coverage_comparison.png", help="Output filename")
     parser.add_argument("--harness", default="jsoncpp_fuzz_cov", help="Coverage harness binary")
+    parser.add_argument("--jobs", type=int, default=os.cpu_count(), help="Parallel replay workers")
     parser.add_argument("--log-scale", action="store_true", help="Use logarithmic scale for time axis")
+    parser.add_argument("--snapshots", help="Colon-separated HARNESS_COV_SNAPSHOT .csv files, one per run; "
+                                            "plots their live edge counts instead of replaying the queues")
     
     args = parser.parse_args()
     
@@ -199,6 +225,12 @@ def main():
     else:
         time_shifts = {run: 0 for run in runs}
     
+    if args.snapshots:
+        runs_data = {run: read_snapshot_csv(csv, time_shifts[run])
+                     for run, csv in zip(runs, args.snapshots.split(":"))}
+        plot_comparison(runs_data, labels, args.output, log_scale=args.log_scale, ylabel='Edges (live)')
+        return
+
     # Find harness
     harness_bin = Path(args.harness).resolve()
     if not harness_bin.exists():
@@ -215,7 +247,8 @@ def main():
         print(f"Analyzing: {run}")
         print(f"{'='*60}")
         
-        queue_dir = (Path(run) / "default" / "queue").resolve()
+        # A run is an afl-fuzz -o directory, or a packed queue of one
+        queue_dir = Path(run).resolve() if is_archive(run) else (Path(run) / "default" / "queue").resolve()
         time_shift = time_shifts[run]
         
         try:
@@ -225,15 +258,15 @@ def main():
             print(f"    Time range: {queue_files[0][0]:.1f}s to {queue_files[-1][0]:.1f}s")
             
             # Run coverage
-            profraw_dir = Path(f"temp_{run.replace('/', '_')}_profraw").resolve()
-            run_coverage_batch(harness_bin, queue_files, profraw_dir)
+            bits_dir = Path(f"temp_{run.replace('/', '_')}_bits").resolve()
+            run_coverage_batch(harness_bin, queue_files, bits_dir, args.jobs)
             
             # Get cumulative coverage
-            data = get_cumulative_coverage(profraw_dir, harness_bin, queue_files, time_shift)
+            data = get_cumulative_coverage(bits_dir, queue_files, time_shift)
             runs_data[run] = data
             
             # Cleanup
-            shutil.rmtree(profraw_dir)
+            shutil.rmtree(bits_dir)
             
         except Exception as e:
             print(f"[!] Error analyzing {run}: {e}")
@@ -243,7 +276,8 @@ def main():
     
     # Generate plot
     if runs_data:
-        plot_comparison(runs_data, labels, args.output, log_scale=args.log_scale)
+        plot_comparison(runs_data, labels, args.output, log_scale=args.log_scale,
+                        ylabel='Profile Counters Covered')
         print("\n[+] Done!")
     else:
         print("[!] No data collected from any runs")
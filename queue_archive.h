@@ -0,0 +1,299 @@
+// Packed AFL++ queues: one file per queue instead of one per entry, written
+// by `queue_archive.py pack QUEUE OUT.qar` and mapped read-only here.
+//
+// Layout (little-endian, offsets from the start of the file):
+//     ArchiveHeader
+//     ArchiveEntry[count]     queue order: by id, then other names
+//     uint32_t ops[numOps]    string offsets of the op tags; ops[0] is ""
+//     strings                 NUL-terminated entry names and op tags
+//     data                    entry bytes, back to back in entry order
+// The index carries what AFL++ encodes in the file names (id, sources,
+// time, execs, op, +cov), so readers need no name parsing, and a replay
+// reads the data section front to back.
+//
+// The tools name archive members ARCHIVE.qar#INDEX. collectInputs expands
+// ARCHIVE.qar to all of its members and ARCHIVE.qar#BEGIN-END to
+// [BEGIN, END), and Input::open serves a member straight from the mapping.
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace harness {
+
+struct ArchiveHeader {
+    static constexpr char kMagic[8] = {'A', 'F', 'L', 'Q', 'A', 'R', '0', '1'};
+    static constexpr uint32_t kVersion = 1;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t count;          // entries
+    uint32_t numOps;         // op tags, "" included
+    uint32_t reserved;
+    uint64_t entriesOffset;
+    uint64_t opsOffset;
+    uint64_t stringsOffset;
+    uint64_t stringsSize;
+    uint64_t dataOffset;
+};
+static_assert(sizeof(ArchiveHeader) == 64, "written by queue_archive.py");
+
+struct ArchiveEntry {
+    static constexpr uint32_t kNoId = UINT32_MAX;     // id, src: not in the name
+    static constexpr uint64_t kNoTime = UINT64_MAX;   // time, execs: likewise
+    static constexpr uint16_t kCov = 1;               // flags: "+cov"
+
+    uint64_t offset;         // of the bytes
+    uint64_t timeMs;
+    uint64_t execs;
+    uint32_t size;
+    uint32_t id;
+    uint32_t src[2];         // splices have two
+    uint32_t name;           // string offset
+    uint16_t op;             // index into ops
+    uint16_t flags;
+};
+static_assert(sizeof(ArchiveEntry) == 48, "written by queue_archive.py");
+
+class QueueArchive {
+public:
+    QueueArchive() = default;
+    QueueArchive(const QueueArchive &) = delete;
+    QueueArchive &operator=(const QueueArchive &) = delete;
+
+    ~QueueArchive() {
+        if (base_)
+            munmap(const_cast<uint8_t *>(base_), size_);
+    }
+
+    // Maps path and checks every offset; false with errno set (EINVAL for
+    // a file that is not a valid archive) otherwise.
+    bool open(const char *path) {
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(ArchiveHeader)) {
+            ::close(fd);
+            errno = EINVAL;
+            return false;
+        }
+        void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED)
+            return false;
+        base_ = static_cast<const uint8_t *>(p);
+        size_ = st.st_size;
+        // Replays read the data section in order
+        madvise(p, size_, MADV_SEQUENTIAL);
+        if (!validate()) {
+            munmap(p, size_);
+            base_ = nullptr;
+            errno = EINVAL;
+            return false;
+        }
+        return true;
+    }
+
+    size_t count() const {
+        return header().count;
+    }
+
+    const ArchiveEntry &entry(size_t i) const {
+        return entries()[i];
+    }
+
+    const uint8_t *data(size_t i) const {
+        return base_ + entries()[i].offset;
+    }
+
+    size_t size(size_t i) const {
+        return entries()[i].size;
+    }
+
+    std::string_view name(size_t i) const {
+        return string(entries()[i].name);
+    }
+
+    std::string_view op(size_t i) const {
+        return string(ops()[entries()[i].op]);
+    }
+
+private:
+    const ArchiveHeader &header() const {
+        return *reinterpret_cast<const ArchiveHeader *>(base_);
+    }
+
+    const ArchiveEntry *entries() const {
+        return reinterpret_cast<const ArchiveEntry *>(base_ + header().entriesOffset);
+    }
+
+    const uint32_t *ops() const {
+        return reinterpret_cast<const uint32_t *>(base_ + header().opsOffset);
+    }
+
+    std::string_view string(uint32_t offset) const {
+        return reinterpret_cast<const char *>(base_ + header().stringsOffset + offset);
+    }
+
+    // Bounds only: a corrupt archive fails here rather than mid-replay
+    bool validate() const {
+        const ArchiveHeader &h = header();
+        auto fits = [&](uint64_t offset, uint64_t bytes) {
+            return offset <= size_ && bytes <= size_ - offset;
+        };
+        if (std::memcmp(h.magic, ArchiveHeader::kMagic, sizeof(h.magic)) != 0 ||
+            h.version != ArchiveHeader::kVersion || h.numOps == 0 ||
+            h.entriesOffset % alignof(ArchiveEntry) || h.opsOffset % alignof(uint32_t) ||
+            !fits(h.entriesOffset, uint64_t{h.count} * sizeof(ArchiveEntry)) ||
+            !fits(h.opsOffset, uint64_t{h.numOps} * sizeof(uint32_t)) ||
+            !fits(h.stringsOffset, h.stringsSize) || h.stringsSize == 0 ||
+            base_[h.stringsOffset + h.stringsSize - 1] != 0 || !fits(h.dataOffset, 0))
+            return false;
+        for (uint32_t k = 0; k < h.numOps; ++k) {
+            if (ops()[k] >= h.stringsSize)
+                return false;
+        }
+        for (uint32_t i = 0; i < h.count; ++i) {
+            const ArchiveEntry &e = entries()[i];
+            if (e.offset < h.dataOffset || !fits(e.offset, e.size) || e.name >= h.stringsSize || e.op >= h.numOps)
+                return false;
+        }
+        return true;
+    }
+
+    const uint8_t *base_ = nullptr;
+    size_t size_ = 0;
+};
+
+inline bool isArchivePath(std::string_view path) {
+    constexpr std::string_view kSuffix = ".qar";
+    return path.size() > kSuffix.size() && path.substr(path.size() - kSuffix.size()) == kSuffix;
+}
+
+// Splits ARCHIVE.qar#SPEC into the archive path and SPEC; false for a
+// plain path.
+inline bool splitMember(std::string_view ref, std::string_view &archive, std::string_view &spec) {
+    size_t hash = ref.rfind('#');
+    if (hash == std::string_view::npos || !isArchivePath(ref.substr(0, hash)))
+        return false;
+    archive = ref.substr(0, hash);
+    spec = ref.substr(hash + 1);
+    return true;
+}
+
+// Archives opened so far, mapped until exit. Shared by --batch workers.
+class ArchiveCache {
+public:
+    // nullptr (errno set) if path cannot be opened as an archive
+    const QueueArchive *get(std::string_view path) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = archives_.find(path);
+        if (it != archives_.end())
+            return it->second.get();
+        auto archive = std::make_unique<QueueArchive>();
+        if (!archive->open(std::string(path).c_str()))
+            return nullptr;
+        return archives_.emplace(std::string(path), std::move(archive)).first->second.get();
+    }
+
+private:
+    std::mutex mutex_;
+    std::map<std::string, std::unique_ptr<QueueArchive>, std::less<>> archives_;
+};
+
+inline ArchiveCache &archiveCache() {
+    static ArchiveCache cache;
+    return cache;
+}
+
+// The member ARCHIVE.qar#INDEX names, or nullptr (errno set) for a plain
+// path, a bad index or an unreadable archive.
+inline const QueueArchive *archiveMember(std::string_view ref, size_t &index) {
+    std::string_view archivePath, spec;
+    errno = ENOENT;
+    if (!splitMember(ref, archivePath, spec) || spec.empty())
+        return nullptr;
+    index = 0;
+    for (char c : spec) {
+        if (c < '0' || c > '9')
+            return nullptr;
+        index = index * 10 + (c - '0');
+    }
+    const QueueArchive *archive = archiveCache().get(archivePath);
+    if (archive && index >= archive->count()) {
+        errno = ENOENT;
+        return nullptr;
+    }
+    return archive;
+}
+
+// Appends the members ARCHIVE.qar (all of them) or ARCHIVE.qar#BEGIN-END
+// (END may be left out) stands for; false if ref is neither, such as a
+// plain path or a single member. A range that is malformed, reversed,
+// empty or past the last member is appended as it is, so it fails to open
+// and is reported like a missing ARCHIVE.qar#INDEX.
+inline bool appendMembers(const std::string &ref, std::vector<std::string> &out) {
+    std::string_view archivePath = ref, spec;
+    size_t begin = 0, end = SIZE_MAX;
+    if (!isArchivePath(ref)) {
+        size_t dash;
+        if (!splitMember(ref, archivePath, spec) || (dash = spec.find('-')) == std::string_view::npos)
+            return false;
+        auto number = [](std::string_view digits, size_t &n) {
+            n = 0;
+            for (char c : digits) {
+                if (c < '0' || c > '9')
+                    return false;
+                n = n * 10 + (c - '0');
+            }
+            return !digits.empty();
+        };
+        if (!number(spec.substr(0, dash), begin) ||
+            (dash + 1 < spec.size() && !number(spec.substr(dash + 1), end))) {
+            out.push_back(ref);
+            return true;
+        }
+    }
+    const QueueArchive *archive = archiveCache().get(archivePath);
+    if (!archive) {
+        std::fprintf(stderr, "[harness] cannot open archive %.*s: %s\n", static_cast<int>(archivePath.size()),
+                     archivePath.data(), errno == EINVAL ? "not a queue archive" : std::strerror(errno));
+        return true;
+    }
+    end = std::min(end, archive->count());
+    if (begin >= end && !isArchivePath(ref)) {
+        out.push_back(ref);
+        return true;
+    }
+    const std::string prefix = std::string(archivePath) + "#";
+    for (size_t i = begin; i < end; ++i)
+        out.push_back(prefix + std::to_string(i));
+    return true;
+}
+
+// What an input is called when written out: an archive member's queue
+// name, or a path's last component.
+inline std::string inputName(const std::string &path) {
+    size_t index;
+    if (const QueueArchive *archive = archiveMember(path, index))
+        return std::string(archive->name(index));
+    return path.substr(path.find_last_of('/') + 1);
+}
+
+} // namespace harness
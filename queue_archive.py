@@ -0,0 +1,194 @@
+#!/usr/bin/env python3
+"""Pack an AFL++ queue into one indexed, memory-mapped archive, and read it.
+
+    python3 queue_archive.py pack out2/default/queue out2/default/queue.qar
+    python3 queue_archive.py list out2/default/queue.qar
+    python3 queue_archive.py count out2/default/queue.qar
+
+The layout is described in queue_archive.h. The index holds each entry's
+offset, length, id, source ids, time, execs, op tag and +cov flag, parsed
+from its file name once at pack time. The harnesses, encoder --batch,
+seed.py, coverage.sh and plot_coverage_fast.py take ARCHIVE.qar wherever
+they take a queue directory, and name a member ARCHIVE.qar#INDEX.
+"""
+
+import argparse
+import mmap
+import struct
+import sys
+from collections import namedtuple
+from pathlib import Path
+
+MAGIC = b"AFLQAR01"
+VERSION = 1
+HEADER = struct.Struct("<8sIIIIQQQQQ")   # ArchiveHeader, 64 bytes
+ENTRY = struct.Struct("<QQQIIIIIHH")     # ArchiveEntry, 48 bytes
+NO_ID = 0xFFFFFFFF
+NO_TIME = 0xFFFFFFFFFFFFFFFF
+FLAG_COV = 1
+
+Entry = namedtuple("Entry", "index name id sources time_ms execs op cov offset size")
+
+
+def parse_name(name):
+    """AFL++ queue name fields: id:000123,src:000004+000010,time:...,op:splice,+cov"""
+    fields = {"id": NO_ID, "src": (NO_ID, NO_ID), "time": NO_TIME, "execs": NO_TIME, "op": "", "cov": False}
+    for part in name.split(","):
+        key, sep, value = part.partition(":")
+        try:
+            if part == "+cov":
+                fields["cov"] = True
+            elif not sep:
+                continue
+            elif key == "id":
+                fields["id"] = int(value)
+            elif key == "src":
+                ids = [int(s) for s in value.split("+")[:2]]
+                fields["src"] = (ids + [NO_ID])[:2]
+            elif key in ("time", "execs"):
+                fields[key] = int(value)
+            elif key == "op":
+                fields["op"] = value
+            elif key in ("orig", "sync"):
+                # A seed or an entry imported from another instance; orig's
+                # value is a file name and may hold commas, so stop here
+                fields["op"] = key
+                if key == "orig":
+                    break
+        except ValueError:
+            continue
+    return fields
+
+
+def pack(queue_dir, out_path):
+    files = [p for p in Path(queue_dir).iterdir() if p.is_file() and not p.name.startswith(".")]
+    parsed = [(parse_name(p.name), p) for p in files]
+    # Queue order, which is discovery order; names without an id go last
+    parsed.sort(key=lambda fp: (fp[0]["id"] == NO_ID, fp[0]["id"], fp[1].name))
+
+    strings = bytearray(b"\0")   # offset 0 is ""
+    ops = {"": 0}
+    op_offsets = [0]
+    names = []
+    for fields, path in parsed:
+        names.append(len(strings))
+        strings += path.name.encode() + b"\0"
+        if fields["op"] not in ops:
+            ops[fields["op"]] = len(op_offsets)
+            op_offsets.append(len(strings))
+            strings += fields["op"].encode() + b"\0"
+
+    entries_offset = HEADER.size
+    ops_offset = entries_offset + ENTRY.size * len(parsed)
+    strings_offset = ops_offset + 4 * len(op_offsets)
+    data_offset = strings_offset + len(strings)
+    data_offset += -data_offset % 64
+
+    out_path = Path(out_path)
+    tmp = out_path.with_name(out_path.name + ".tmp")
+    with open(tmp, "wb") as out:
+        out.write(HEADER.pack(MAGIC, VERSION, len(parsed), len(op_offsets), 0, entries_offset,
+                              ops_offset, strings_offset, len(strings), data_offset))
+        offset = data_offset
+        blobs = []
+        for (fields, path), name in zip(parsed, names):
+            blob = path.read_bytes()
+            blobs.append(blob)
+            src = fields["src"]
+            out.write(ENTRY.pack(offset, fields["time"], fields["execs"], len(blob), fields["id"],
+                                 src[0], src[1], name, ops[fields["op"]], FLAG_COV if fields["cov"] else 0))
+            offset += len(blob)
+        out.write(struct.pack(f"<{len(op_offsets)}I", *op_offsets))
+        out.write(strings)
+        out.write(b"\0" * (data_offset - strings_offset - len(strings)))
+        for blob in blobs:
+            out.write(blob)
+    tmp.replace(out_path)   # readers never see a half-written archive
+    return len(parsed), offset - data_offset
+
+
+class QueueArchive:
+    """Read-only view of a .qar; data() slices the mapping without copying."""
+
+    def __init__(self, path):
+        self.path = str(path)
+        with open(path, "rb") as f:
+            self._map = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        self._view = memoryview(self._map)
+        (magic, version, count, num_ops, _, entries_offset, ops_offset,
+         strings_offset, strings_size, _) = HEADER.unpack_from(self._map, 0)
+        if magic != MAGIC or version != VERSION:
+            raise ValueError(f"{path}: not a version {VERSION} queue archive")
+        strings = self._map[strings_offset:strings_offset + strings_size]
+
+        def string(offset):
+            return strings[offset:strings.index(b"\0", offset)].decode(errors="replace")
+
+        op_names = [string(o) for o in struct.unpack_from(f"<{num_ops}I", self._map, ops_offset)]
+        self.entries = []
+        for i, fields in enumerate(ENTRY.iter_unpack(self._map[entries_offset:entries_offset + ENTRY.size * count])):
+            offset, time_ms, execs, size, id_, src0, src1, name, op, flags = fields
+            self.entries.append(Entry(
+                index=i, name=string(name), id=None if id_ == NO_ID else id_,
+                sources=tuple(s for s in (src0, src1) if s != NO_ID),
+                time_ms=None if time_ms == NO_TIME else time_ms,
+                execs=None if execs == NO_TIME else execs,
+                op=op_names[op], cov=bool(flags & FLAG_COV), offset=offset, size=size))
+
+    def __len__(self):
+        return len(self.entries)
+
+    def data(self, entry):
+        return self._view[entry.offset:entry.offset + entry.size]
+
+    def member(self, entry):
+        """The name the C++ tools take for this entry."""
+        return f"{self.path}#{entry.index}"
+
+    def close(self):
+        self._view.release()
+        self._map.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+
+def is_archive(path):
+    return str(path).endswith(".qar") and Path(path).is_file()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="AFL++ queue archive packer")
+    sub = parser.add_subparsers(dest="command", required=True)
+    p = sub.add_parser("pack", help="Pack a queue directory into one archive")
+    p.add_argument("queue", help="AFL++ queue directory, e.g. out2/default/queue")
+    p.add_argument("output", help="Archive to write, e.g. out2/default/queue.qar")
+    p = sub.add_parser("list", help="Print the index as TSV")
+    p.add_argument("archive")
+    p = sub.add_parser("count", help="Print the number of entries")
+    p.add_argument("archive")
+    args = parser.parse_args()
+
+    if args.command == "pack":
+        if not Path(args.queue).is_dir():
+            sys.exit(f"[!] Queue directory not found: {args.queue}")
+        count, size = pack(args.queue, args.output)
+        print(f"[+] Packed {count} entries ({size} bytes) into {args.output}")
+        return
+
+    with QueueArchive(args.archive) as archive:
+        if args.command == "count":
+            print(len(archive))
+            return
+        print("index\tid\tsources\ttime_ms\texecs\top\tcov\tsize\tname")
+        for e in archive.entries:
+            print(f"{e.index}\t{'' if e.id is None else e.id}\t{'+'.join(map(str, e.sources))}\t"
+                  f"{'' if e.time_ms is None else e.time_ms}\t{'' if e.execs is None else e.execs}\t"
+                  f"{e.op}\t{int(e.cov)}\t{e.size}\t{e.name}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,214 @@
+// Runtime choice of JsonEncoder's value-token weights, plus optional
+// coverage feedback that suggests better ones.
+//
+// loadTokenWeights() installs the table once per process, from the first of
+//   - ENCODER_TOKEN_WEIGHTS in the environment,
+//   - -DENCODER_TOKEN_WEIGHTS="\"array=8,object=8\"" at build time,
+// using json_tokens::parseWeights syntax; "@FILE" reads the weights a
+// feedback file suggests. Without either the default map is kept.
+//
+// With ENCODER_TOKEN_FEEDBACK=FILE and a coverage source (harness_cov.h),
+// the harness counts how often each value token is decoded and how often it
+// is part of an exec that reached a new (edge, hit bucket) feature. At exit
+// the counts are added to FILE, whose first line suggests weights
+// proportional to each token's new coverage per use, for the next run. The
+// table never changes during a run: queue entries must keep decoding the
+// same way for AFL++ to trust them.
+#pragma once
+
+#include <array>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "harness_cov.h"
+#include "json_encoder.h"
+
+namespace harness {
+
+constexpr const char *kSuggestedWeightsPrefix = "# ENCODER_TOKEN_WEIGHTS=";
+
+// Name of a value token, for feedback files.
+inline std::string tokenName(size_t token) {
+    const json_tokens::Token &t = json_tokens::kGeneralTokens[token];
+    if (t.kind == json_tokens::Kind::Array)
+        return "array";
+    if (t.kind == json_tokens::Kind::Object)
+        return "object";
+    return std::string(t.text, t.length);
+}
+
+// Weights suggested by a feedback file ("" if it has none).
+inline std::string suggestedWeights(const char *path) {
+    std::string suggestion;
+    if (FILE *f = std::fopen(path, "r")) {
+        char line[1024];
+        if (std::fgets(line, sizeof(line), f) &&
+            std::strncmp(line, kSuggestedWeightsPrefix, std::strlen(kSuggestedWeightsPrefix)) == 0) {
+            suggestion = line + std::strlen(kSuggestedWeightsPrefix);
+            while (!suggestion.empty() && (suggestion.back() == '\n' || suggestion.back() == '\r'))
+                suggestion.pop_back();
+        }
+        std::fclose(f);
+    }
+    return suggestion;
+}
+
+inline void loadTokenWeights() {
+    static bool loaded = false;
+    if (loaded)
+        return;
+    loaded = true;
+
+    const char *spec = std::getenv("ENCODER_TOKEN_WEIGHTS");
+#ifdef ENCODER_TOKEN_WEIGHTS
+    if (!spec)
+        spec = ENCODER_TOKEN_WEIGHTS;
+#endif
+    if (!spec || !*spec)
+        return;
+
+    std::string fromFile;
+    if (spec[0] == '@') {
+        fromFile = suggestedWeights(spec + 1);
+        if (fromFile.empty()) {
+            std::fprintf(stderr, "[harness] no suggested weights in %s; using the default token map\n", spec + 1);
+            return;
+        }
+        spec = fromFile.c_str();
+    }
+
+    json_tokens::Weights weights = json_tokens::equalWeights();
+    if (!json_tokens::parseWeights(spec, weights)) {
+        std::fprintf(stderr, "[harness] bad ENCODER_TOKEN_WEIGHTS \"%s\"; using the default token map\n", spec);
+        return;
+    }
+    static json_tokens::ValueMap map;
+    map = json_tokens::makeWeightedValueTokenOf(weights);
+    JsonEncoder::setValueMap(map);
+}
+
+class TokenFeedback {
+public:
+    TokenFeedback() : path_(std::getenv("ENCODER_TOKEN_FEEDBACK")) {
+        if (path_ && !coverageAvailable()) {
+            std::fprintf(stderr, "[harness] ENCODER_TOKEN_FEEDBACK needs an afl-clang-fast or "
+                                 "-DHARNESS_SANCOV build; ignoring it\n");
+            path_ = nullptr;
+        }
+    }
+    TokenFeedback(const TokenFeedback &) = delete;
+    TokenFeedback &operator=(const TokenFeedback &) = delete;
+
+    ~TokenFeedback() {
+        if (path_)
+            dump();
+    }
+
+    bool enabled() const {
+        return path_ != nullptr;
+    }
+
+    // Under afl-fuzz resetCoverage() leaves the fuzzer's map alone: afl-fuzz
+    // cleared it before this exec, and the edges so far are its coverage.
+    void beginExec() {
+        if (!path_)
+            return;
+        current_.fill(0);
+        resetCoverage();
+    }
+
+    // Tallies the value tokens of one encoder input, decoded with the
+    // current limits.
+    void document(const uint8_t *data, size_t size, size_t maxDepth, size_t maxNodes) {
+        if (!path_)
+            return;
+        JsonEncoder enc(data, size, maxDepth, maxNodes);
+        enc.describe(nodes_);
+        const json_tokens::ValueMap &map = JsonEncoder::valueMap();
+        for (const JsonEncoder::Node &n : nodes_)
+            ++current_[map[n.begin < size ? data[n.begin] : 0]];
+    }
+
+    // Credits this exec's tokens if it reached a feature no earlier exec did.
+    void endExec() {
+        if (!path_)
+            return;
+        bool novel = false;
+        forEachEdge([&](uint32_t edge, uint8_t count) {
+            size_t feature = static_cast<size_t>(edge) * 8 + hitBucket(count);
+            if (feature >= seen_.size())
+                seen_.resize(feature + 1);
+            if (!seen_[feature]) {
+                seen_[feature] = true;
+                novel = true;
+            }
+        });
+        for (size_t t = 0; t < json_tokens::kNumGeneralTokens; ++t) {
+            uses_[t] += current_[t];
+            if (novel)
+                wins_[t] += current_[t];
+        }
+    }
+
+    // Adds this process's counts to the file and rewrites its suggestion:
+    // weight ~ (wins + 1) / (uses + 1), scaled so the best token gets 64.
+    void dump() const {
+        std::array<uint64_t, json_tokens::kNumGeneralTokens> uses = uses_, wins = wins_;
+        if (FILE *f = std::fopen(path_, "r")) {
+            char line[256];
+            while (std::fgets(line, sizeof(line), f)) {
+                unsigned t;
+                unsigned long long u, w;
+                if (line[0] != '#' && std::sscanf(line, "%u %llu %llu", &t, &u, &w) == 3 &&
+                    t < json_tokens::kNumGeneralTokens) {
+                    uses[t] += u;
+                    wins[t] += w;
+                }
+            }
+            std::fclose(f);
+        }
+
+        double best = 0;
+        std::array<double, json_tokens::kNumGeneralTokens> rate{};
+        for (size_t t = 0; t < rate.size(); ++t) {
+            rate[t] = (wins[t] + 1.0) / (uses[t] + 1.0);
+            best = rate[t] > best ? rate[t] : best;
+        }
+
+        std::string tmp = std::string(path_) + ".tmp";
+        FILE *f = std::fopen(tmp.c_str(), "w");
+        if (!f) {
+            std::fprintf(stderr, "[harness] cannot write %s: %s\n", tmp.c_str(), std::strerror(errno));
+            return;
+        }
+        std::fputs(kSuggestedWeightsPrefix, f);
+        for (size_t t = 0; t < rate.size(); ++t)
+            std::fprintf(f, "%s%u", t ? "," : "", 1 + static_cast<unsigned>(63 * rate[t] / best));
+        std::fprintf(f, "\n# token uses new_coverage_uses name\n");
+        for (size_t t = 0; t < rate.size(); ++t) {
+            std::fprintf(f, "%zu %llu %llu %s\n", t,
+                         static_cast<unsigned long long>(uses[t]),
+                         static_cast<unsigned long long>(wins[t]), tokenName(t).c_str());
+        }
+        std::fclose(f);
+        std::rename(tmp.c_str(), path_);
+    }
+
+private:
+    const char *path_;
+    std::array<uint64_t, json_tokens::kNumGeneralTokens> current_{};
+    std::array<uint64_t, json_tokens::kNumGeneralTokens> uses_{};
+    std::array<uint64_t, json_tokens::kNumGeneralTokens> wins_{};
+    std::vector<bool> seen_;
+    std::vector<JsonEncoder::Node> nodes_;
+};
+
+inline TokenFeedback &tokenFeedback() {
+    static TokenFeedback feedback;
+    return feedback;
+}
+
+} // namespace harness